@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include "chain_order.h"
+#include "parallel_for.h"
+#include "spatial_index.h"
+
+namespace ohtoai {
+	/**
+	 * AutoGroupOptions，自动分组参数
+	 */
+	struct AutoGroupOptions {
+		/**
+		 * 每个房屋组最多的住户数
+		 */
+		size_t max_houses{ 8 };
+		/**
+		 * 沿希尔伯特曲线相邻的两户距离超过该值时不放入同一组，
+		 * 为空时取曲线上相邻两户距离中位数的4倍，使分散的住户团不被连在一起
+		 */
+		std::optional<double> max_gap;
+		/**
+		 * 组端点到首尾住户的距离，朝最近的电线杆方向放置
+		 */
+		double endpoint_offset{ 1.0 };
+		/**
+		 * 组内排序的总时间预算（毫秒）
+		 */
+		size_t budget{ 1000 };
+
+		static AutoGroupOptions fromJson(const nlohmann::json& j)
+		{
+			AutoGroupOptions options;
+			if (j.is_null())
+			{
+				return options;
+			}
+			options.max_houses = j.value("max_houses", options.max_houses);
+			if (j.contains("max_gap") && !j.at("max_gap").is_null())
+			{
+				options.max_gap = j.at("max_gap").get<double>();
+			}
+			options.endpoint_offset = j.value("endpoint_offset", options.endpoint_offset);
+			options.budget = j.value("budget", options.budget);
+			if (options.max_houses == 0)
+			{
+				throw std::invalid_argument("max_houses must be positive");
+			}
+			return options;
+		}
+	};
+
+	// (x, y)在2^16×2^16网格上沿希尔伯特曲线的序号
+	inline uint64_t hilbertIndex(uint32_t x, uint32_t y)
+	{
+		constexpr uint32_t n = 1u << 16;
+		uint64_t d = 0;
+		for (uint32_t s = n / 2; s > 0; s /= 2)
+		{
+			uint32_t rx = (x & s) > 0 ? 1 : 0;
+			uint32_t ry = (y & s) > 0 ? 1 : 0;
+			d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					x = n - 1 - x;
+					y = n - 1 - y;
+				}
+				std::swap(x, y);
+			}
+		}
+		return d;
+	}
+
+	/**
+	 * AutoGrouper，把散列的住户自动分成房屋组，生成完整的MapInfo
+	 *
+	 * 住户按希尔伯特曲线排序后顺序切分（带容量的扫描）：相距超过max_gap处先断开，
+	 * 每段再均分为不超过max_houses户的房屋组，空间上相近的住户落在同一组。
+	 * 组内顺序由optimizeChain确定，组前、组后端点放在首尾住户朝最近电线杆的方向上。
+	 * 计算排序键和组内排序都按房屋组并行，总耗时O(n log n)。
+	 */
+	class AutoGrouper {
+	public:
+		AutoGrouper(std::vector<Hole> houses, std::vector<Hole> poles, AutoGroupOptions options)
+			: houses_{ std::move(houses) }, poles_{ std::move(poles) }, options_{ options }
+		{
+		}
+
+		MapInfo run(size_t threads = std::thread::hardware_concurrency())
+		{
+			auto order = hilbertOrder(threads);
+			auto chunks = cut(order);
+
+			std::vector<PointIndex<size_t>::Entry> entries;
+			for (size_t i = 0; i < poles_.size(); ++i)
+			{
+				entries.push_back({ poles_[i].x, poles_[i].y, i });
+			}
+			PointIndex<size_t> pole_index{ std::move(entries) };
+
+			MapInfo map;
+			map.house_groups.resize(chunks.size());
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.budget);
+			parallelFor(chunks.size(), [&](size_t c) {
+				auto& group = map.house_groups[c];
+				for (auto k = chunks[c].first; k < chunks[c].second; ++k)
+				{
+					group.house_poles.push_back(houses_[order[k]]);
+				}
+				// 端点尚未确定，两端自由地排序
+				group.group_front_valid = group.group_back_valid = false;
+				auto chain = optimizeChain(group, deadline);
+				if (chain.improved())
+				{
+					auto houses = std::move(group.house_poles);
+					for (auto i : chain.order)
+					{
+						group.house_poles.push_back(houses[i]);
+					}
+				}
+				const auto& houses = group.house_poles;
+				group.group_front_pole = endpoint(pole_index, houses.front(), houses.size() > 1 ? &houses[1] : nullptr);
+				group.group_back_pole = endpoint(pole_index, houses.back(), houses.size() > 1 ? &houses[houses.size() - 2] : nullptr);
+				group.group_front_valid = group.group_back_valid = true;
+				}, threads, 64);
+			nameEndpoints(map);
+			map.elec_poles = std::move(poles_);
+			return map;
+		}
+
+	private:
+		std::vector<size_t> hilbertOrder(size_t threads) const
+		{
+			const auto n = houses_.size();
+			std::vector<size_t> order(n);
+			if (n == 0)
+			{
+				return order;
+			}
+			auto min_x = houses_.front().x, max_x = min_x;
+			auto min_y = houses_.front().y, max_y = min_y;
+			for (const auto& house : houses_)
+			{
+				min_x = std::min(min_x, house.x);
+				max_x = std::max(max_x, house.x);
+				min_y = std::min(min_y, house.y);
+				max_y = std::max(max_y, house.y);
+			}
+			// 两个方向等比例量化，保持曲线的空间局部性
+			auto scale = 65535 / std::max({ max_x - min_x, max_y - min_y, 1e-9 });
+			std::vector<std::pair<uint64_t, size_t>> keys(n);
+			parallelFor(n, [&](size_t i) {
+				auto qx = static_cast<uint32_t>((houses_[i].x - min_x) * scale);
+				auto qy = static_cast<uint32_t>((houses_[i].y - min_y) * scale);
+				keys[i] = { hilbertIndex(qx, qy), i };
+				}, threads, 4096);
+			std::sort(keys.begin(), keys.end());
+			for (size_t i = 0; i < n; ++i)
+			{
+				order[i] = keys[i].second;
+			}
+			return order;
+		}
+
+		// 切分为[first, second)区间：先按max_gap断开，每段再均分
+		std::vector<std::pair<size_t, size_t>> cut(const std::vector<size_t>& order) const
+		{
+			std::vector<std::pair<size_t, size_t>> chunks;
+			auto max_gap = options_.max_gap;
+			if (!max_gap && order.size() > 1)
+			{
+				std::vector<double> gaps(order.size() - 1);
+				for (size_t k = 1; k < order.size(); ++k)
+				{
+					gaps[k - 1] = distance(houses_[order[k - 1]], houses_[order[k]]);
+				}
+				std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+				// 重复坐标过半时中位数为0，不再限制
+				if (gaps[gaps.size() / 2] > 0)
+				{
+					max_gap = 4 * gaps[gaps.size() / 2];
+				}
+			}
+			size_t begin = 0;
+			for (size_t k = 1; k <= order.size(); ++k)
+			{
+				auto gap = k == order.size() || (max_gap && distance(houses_[order[k - 1]], houses_[order[k]]) > *max_gap);
+				if (!gap)
+				{
+					continue;
+				}
+				auto length = k - begin;
+				auto count = (length + options_.max_houses - 1) / options_.max_houses;
+				for (size_t c = 0; c < count; ++c)
+				{
+					chunks.push_back({ begin + length * c / count, begin + length * (c + 1) / count });
+				}
+				begin = k;
+			}
+			return chunks;
+		}
+
+		// 端点ID为首尾住户的ID加"-front"、"-back"，与住户、电线杆或已生成的端点重复时再加序号
+		void nameEndpoints(MapInfo& map) const
+		{
+			std::unordered_set<std::string> ids;
+			for (const auto& hole : houses_)
+			{
+				ids.insert(hole.id);
+			}
+			for (const auto& hole : poles_)
+			{
+				ids.insert(hole.id);
+			}
+			auto unique = [&ids](const std::string& base) {
+				auto id = base;
+				for (size_t k = 2; !ids.insert(id).second; ++k)
+				{
+					id = base + "-" + std::to_string(k);
+				}
+				return id;
+			};
+			for (auto& group : map.house_groups)
+			{
+				group.group_front_pole.id = unique(group.house_poles.front().id + "-front");
+				group.group_back_pole.id = unique(group.house_poles.back().id + "-back");
+			}
+		}
+
+		// 住户end外侧的端点：有电线杆时朝最近的电线杆，否则沿链的方向向外，只有一户时向x负方向
+		Hole endpoint(const PointIndex<size_t>& pole_index, const Hole& end, const Hole* inner) const
+		{
+			double dx = -1, dy = 0;
+			if (auto nearest = pole_index.nearest(end.x, end.y, 1); !nearest.empty() && nearest.front().first > 0)
+			{
+				const auto& pole = poles_[nearest.front().second->value];
+				dx = pole.x - end.x;
+				dy = pole.y - end.y;
+			}
+			else if (inner && distance(end, *inner) > 0)
+			{
+				dx = end.x - inner->x;
+				dy = end.y - inner->y;
+			}
+			auto length = std::hypot(dx, dy);
+			auto offset = pole_index.empty() ? options_.endpoint_offset : std::min(options_.endpoint_offset, length);
+			Hole hole;
+			hole.x = end.x + dx / length * offset;
+			hole.y = end.y + dy / length * offset;
+			hole.extra = nlohmann::json::object();
+			return hole;
+		}
+
+		std::vector<Hole> houses_;
+		std::vector<Hole> poles_;
+		AutoGroupOptions options_;
+	};
+}
@@ -0,0 +1,132 @@
+// 房屋组分割的基准测试：比较引入费用模型之前的bestSplit与当前默认欧氏费用模型的bestSplit。
+// 不属于vcxproj的构建，单独编译运行，例如：
+//   g++ -std=c++17 -O2 -I3rd/inc bench_split.cpp -o bench_split -pthread
+//   ./bench_split map.json [rounds]
+// 两种实现在同一进程中交替运行，减少频率和缓存状态带来的偏差，输出每轮耗时的最小值和中位数（毫秒）
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <vector>
+#include "group_split.h"
+
+namespace {
+	using namespace ohtoai;
+
+	// 引入费用模型之前的距离和分割实现，作为对比的基线
+	double baselineDistance(const Hole& h1, const Hole& h2)
+	{
+		return std::sqrt(std::pow(h1.x - h2.x, 2) + std::pow(h1.y - h2.y, 2));
+	}
+
+	GroupSplit baselineBestSplit(const GroupEntry& entry)
+	{
+		const auto& group = entry.group;
+		const auto& houses = group.house_poles;
+		const auto& prefix = entry.prefix;
+		const auto n = houses.size();
+		auto front_usable = group.group_front_valid && !entry.front.elec_id.empty();
+		auto back_usable = group.group_back_valid && !entry.back.elec_id.empty();
+
+		GroupSplit best;
+		if (n == 0 || (!front_usable && !back_usable))
+		{
+			best.feasible = n == 0;
+			return best;
+		}
+		auto front_lead = entry.front.distance + baselineDistance(group.group_front_pole, houses.front());
+		auto back_lead = entry.back.distance + baselineDistance(group.group_back_pole, houses.back());
+		auto best_cable = std::numeric_limits<double>::infinity();
+		for (size_t k = 0; k <= n; ++k)
+		{
+			if ((k > 0 && !front_usable) || (k < n && !back_usable))
+			{
+				continue;
+			}
+			auto front = k == 0 ? 0.0 : front_lead + prefix[k - 1];
+			auto back = k == n ? 0.0 : back_lead + prefix[n - 1] - prefix[k];
+			if (front + back < best_cable)
+			{
+				best_cable = front + back;
+				best = GroupSplit{ true, k, front, back, front + back };
+			}
+		}
+		return best;
+	}
+
+	struct Timing {
+		std::vector<double> samples;
+
+		template <typename Fn>
+		void run(Fn&& fn)
+		{
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		std::pair<double, double> summary() const
+		{
+			auto sorted = samples;
+			std::sort(sorted.begin(), sorted.end());
+			return { sorted.front(), sorted[sorted.size() / 2] };
+		}
+	};
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "usage: %s map.json [rounds]\n", argv[0]);
+		return 2;
+	}
+	std::ifstream ifs(argv[1]);
+	nlohmann::json j;
+	ifs >> j;
+	auto map = MapVersion::build(j.get<MapInfo>(), 1);
+	const auto rounds = argc > 2 ? std::atoi(argv[2]) : 300;
+
+	Timing baseline, current, split_all;
+	double baseline_cable = 0, current_cable = 0;
+	size_t mismatched = 0;
+	for (int r = 0; r < rounds; ++r)
+	{
+		std::vector<GroupSplit> before, after;
+		before.reserve(map->groups.size());
+		after.reserve(map->groups.size());
+		baseline.run([&] {
+			for (const auto& entry : map->groups)
+			{
+				before.push_back(baselineBestSplit(*entry));
+			}
+			});
+		current.run([&] {
+			for (const auto& entry : map->groups)
+			{
+				after.push_back(bestSplit(*entry));
+			}
+			});
+		split_all.run([&] { splitAll(*map, CostModel<EuclideanMetric>{}, 1); });
+		for (size_t i = 0; i < before.size(); ++i)
+		{
+			baseline_cable += before[i].cable();
+			current_cable += after[i].cable();
+			mismatched += before[i].front_houses != after[i].front_houses || before[i].feasible != after[i].feasible ? 1 : 0;
+		}
+	}
+
+	auto [baseline_min, baseline_median] = baseline.summary();
+	auto [current_min, current_median] = current.summary();
+	auto [all_min, all_median] = split_all.summary();
+	std::printf("groups %zu, rounds %d\n", map->groups.size(), rounds);
+	std::printf("bestSplit baseline  min %.3f ms  median %.3f ms\n", baseline_min, baseline_median);
+	std::printf("bestSplit euclidean min %.3f ms  median %.3f ms\n", current_min, current_median);
+	std::printf("splitAll  euclidean min %.3f ms  median %.3f ms (1 thread)\n", all_min, all_median);
+	std::printf("cable baseline %.6f current %.6f, mismatched splits %zu\n", baseline_cable / rounds, current_cable / rounds, mismatched);
+	return mismatched == 0 ? 0 : 1;
+}
@@ -0,0 +1,483 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include "map_store.h"
+
+namespace ohtoai {
+	/**
+	 * CapacityAssignOptions，带容量约束的全局分配参数
+	 */
+	struct CapacityAssignOptions {
+		/**
+		 * 每个有效端点考虑的最近电线杆数，由空间索引的k近邻查询得到
+		 */
+		size_t candidates{ 8 };
+		/**
+		 * 电线杆容量（可供电的住户数）的附加表，优先于电线杆extra中的capacity
+		 */
+		std::unordered_map<std::string, double> capacity;
+		/**
+		 * 两者都没有时的容量，为空表示不限
+		 */
+		std::optional<double> default_capacity;
+		/**
+		 * 房屋组不分配的代价，为空时取候选距离最大值的两倍
+		 */
+		std::optional<double> unassigned_cost;
+		static CapacityAssignOptions fromJson(const nlohmann::json& j)
+		{
+			CapacityAssignOptions options;
+			if (j.is_null())
+			{
+				return options;
+			}
+			options.candidates = j.value("candidates", options.candidates);
+			if (j.contains("capacity"))
+			{
+				options.capacity = j.at("capacity").get<std::unordered_map<std::string, double>>();
+			}
+			if (j.contains("default_capacity"))
+			{
+				options.default_capacity = j.at("default_capacity").get<double>();
+			}
+			if (j.contains("unassigned_cost"))
+			{
+				options.unassigned_cost = j.at("unassigned_cost").get<double>();
+			}
+			return options;
+		}
+	};
+
+	/**
+	 * CapacityAssigner，在电线杆容量约束下为房屋组选择供电端点和电线杆，使引下线总长最小
+	 *
+	 * 每个房屋组作为一个整体（负载为住户数）只从一个端点接入一个电线杆。
+	 * 使用逐次最短路的最小费用流：房屋组逐个加入，从新房屋组出发在剩余网络中找到费用最小的增广路，
+	 * 路径为"房屋组 → 电线杆 → 改接该电线杆上已有的房屋组 → 另一电线杆 ..."，终点为有余量的电线杆或"不分配"。
+	 * 节点势使各边的约化费用非负，最短路用Dijkstra求出，容量充足时通常第一个弹出的电线杆就是终点。
+	 * 候选只取每个端点的k近邻，同一电线杆从两端点都可达时取较近的一端；"不分配"选项保证电线杆不足时也能结束。
+	 * 所有房屋组负载相同时（如每组一户）即为标准的最小费用流，结果在候选边上最优；
+	 * 负载不同时房屋组不可拆分，问题为装箱的变体，改接只在腾出的容量足够时进行，结果为启发式，exact为false。
+	 */
+	class CapacityAssigner {
+	public:
+		CapacityAssigner(const MapVersion& map, CapacityAssignOptions options)
+			: map_{ map }, options_{ std::move(options) }
+		{
+		}
+
+		nlohmann::json run()
+		{
+			prepare();
+			solve();
+			return result();
+		}
+
+	private:
+		struct Candidate {
+			int slot;
+			size_t pole;
+			double distance;
+		};
+
+		static constexpr int unassigned = -1;
+
+		double capacityOf(const Hole& pole) const
+		{
+			if (auto it = options_.capacity.find(pole.id); it != options_.capacity.end())
+			{
+				return it->second;
+			}
+			if (pole.extra.is_object() && pole.extra.contains("capacity") && pole.extra.at("capacity").is_number())
+			{
+				return pole.extra.at("capacity").get<double>();
+			}
+			return options_.default_capacity.value_or(std::numeric_limits<double>::infinity());
+		}
+
+		void prepare()
+		{
+			const auto& poles = map_.elec->poles;
+			capacity_.resize(poles.size());
+			for (size_t j = 0; j < poles.size(); ++j)
+			{
+				capacity_[j] = capacityOf(poles[j]);
+			}
+
+			const auto& groups = map_.groups;
+			weight_.resize(groups.size());
+			candidates_.resize(groups.size());
+			double max_distance = 0;
+			for (size_t i = 0; i < groups.size(); ++i)
+			{
+				const auto& group = groups[i]->group;
+				weight_[i] = static_cast<double>(group.house_poles.size());
+				// 容量装不下整个房屋组的电线杆不作为候选
+				auto fits = [this, i](const PointIndex<std::string>::Entry& e) {
+					return capacity_[map_.elec->by_id.at(e.value)] >= weight_[i];
+				};
+				auto& candidates = candidates_[i];
+				for (const auto& [endpoint, valid, slot] : { std::tuple{ &group.group_front_pole, group.group_front_valid, GroupPoint::front_slot },
+					std::tuple{ &group.group_back_pole, group.group_back_valid, GroupPoint::back_slot } })
+				{
+					if (!valid)
+					{
+						continue;
+					}
+					for (const auto& [distance, e] : map_.elec->index.nearest(endpoint->x, endpoint->y, options_.candidates, fits))
+					{
+						auto pole = map_.elec->by_id.at(e->value);
+						auto same = std::find_if(candidates.begin(), candidates.end(), [pole](const Candidate& c) { return c.pole == pole; });
+						if (same == candidates.end())
+						{
+							candidates.push_back({ slot, pole, distance });
+						}
+						else if (distance < same->distance)
+						{
+							*same = { slot, pole, distance };
+						}
+						max_distance = std::max(max_distance, distance);
+					}
+				}
+			}
+			unassigned_cost_ = options_.unassigned_cost.value_or(2 * max_distance + 1);
+		}
+
+		// 节点编号：房屋组[0, G)，电线杆[G, G + P)，"不分配"为G + P，汇点为G + P + 1。
+		// 有余量的电线杆和"不分配"以费用0的边连到汇点
+		size_t poleNode(size_t pole) const
+		{
+			return map_.groups.size() + pole;
+		}
+
+		size_t sinkNode() const
+		{
+			return map_.groups.size() + capacity_.size();
+		}
+
+		size_t terminalNode() const
+		{
+			return sinkNode() + 1;
+		}
+
+		void solve()
+		{
+			const auto group_count = map_.groups.size();
+			const auto node_count = terminalNode() + 1;
+			load_.assign(capacity_.size(), 0.0);
+			// 最后一项为未分配的房屋组
+			holders_.assign(capacity_.size() + 1, {});
+			choice_.assign(group_count, unassigned);
+			potential_.assign(node_count, 0.0);
+			distance_.assign(node_count, inf);
+			previous_.assign(node_count, none);
+			settled_.assign(node_count, false);
+			augmentations_ = 0;
+			// 负载大的房屋组先加入，与装箱的降序首次适应相同，负载相同时按下标顺序
+			std::vector<size_t> order(group_count);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return weight_[a] > weight_[b]; });
+			for (auto i : order)
+			{
+				if (!candidates_[i].empty())
+				{
+					augment(i);
+				}
+			}
+		}
+
+		// 房屋组当前所在的电线杆节点，未分配时为"不分配"
+		size_t nodeOf(size_t group) const
+		{
+			return choice_[group] == unassigned ? sinkNode() : poleNode(candidates_[group][choice_[group]].pole);
+		}
+
+		// 房屋组i接到节点v（电线杆或"不分配"）的费用
+		double costTo(size_t i, size_t v) const
+		{
+			if (v == sinkNode())
+			{
+				return unassigned_cost_;
+			}
+			for (const auto& c : candidates_[i])
+			{
+				if (poleNode(c.pole) == v)
+				{
+					return c.distance;
+				}
+			}
+			return inf;
+		}
+
+		// 从房屋组start出发用Dijkstra求约化费用最短的增广路并沿路改接，再更新节点势
+		void augment(size_t start)
+		{
+			using Item = std::pair<double, size_t>;
+			std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+			std::vector<size_t> touched{ start };
+			std::vector<size_t> settled;
+			distance_[start] = 0;
+			heap.push({ 0.0, start });
+			// 负载不同时约化费用可能为负，已确定的节点不再更新，保证前驱构成树
+			auto relax = [&](size_t u, size_t v, double cost) {
+				auto d = distance_[u] + cost + potential_[u] - potential_[v];
+				if (!settled_[v] && d < distance_[v])
+				{
+					if (std::isinf(distance_[v]))
+					{
+						touched.push_back(v);
+					}
+					distance_[v] = d;
+					previous_[v] = u;
+					heap.push({ d, v });
+				}
+			};
+
+			const auto group_count = map_.groups.size();
+			size_t end = none;
+			while (!heap.empty())
+			{
+				auto [d, u] = heap.top();
+				heap.pop();
+				if (settled_[u] || d > distance_[u])
+				{
+					continue;
+				}
+				settled_[u] = true;
+				settled.push_back(u);
+				if (u < group_count)
+				{
+					// 房屋组改接到其他候选电线杆或"不分配"，新加入的房屋组尚未接到任何节点
+					auto current = nodeOf(u);
+					for (const auto& c : candidates_[u])
+					{
+						auto v = poleNode(c.pole);
+						if (v != current)
+						{
+							relax(u, v, c.distance);
+						}
+					}
+					if (current != sinkNode() || u == start)
+					{
+						relax(u, sinkNode(), unassigned_cost_);
+					}
+					continue;
+				}
+				if (u == terminalNode())
+				{
+					end = previous_[u];
+					break;
+				}
+				if (u == sinkNode())
+				{
+					relax(u, terminalNode(), 0);
+					for (auto h : holders_.back())
+					{
+						relax(u, h, -unassigned_cost_);
+					}
+					continue;
+				}
+				// 电线杆：有余量接入到达它的房屋组时连到汇点，同时可以逐出其上的房屋组继续
+				auto pole = u - group_count;
+				auto incoming = weight_[previous_[u]];
+				if (load_[pole] + incoming <= capacity_[pole])
+				{
+					relax(u, terminalNode(), 0);
+				}
+				for (auto h : holders_[pole])
+				{
+					if (load_[pole] - weight_[h] + incoming <= capacity_[pole])
+					{
+						relax(u, h, -costTo(h, u));
+					}
+				}
+			}
+
+			if (end != none)
+			{
+				// 沿路径从终点往回改接：每个"电线杆 ← 房屋组"段把房屋组接到该电线杆上
+				for (auto v = end;;)
+				{
+					auto g = previous_[v];
+					move(g, v);
+					if (g == start)
+					{
+						break;
+					}
+					v = previous_[g];
+				}
+				// 已确定最短距离的节点势加上(距离 - 汇点距离)，其余节点相当于整体平移，不影响约化费用
+				auto limit = distance_[terminalNode()];
+				for (auto v : settled)
+				{
+					potential_[v] += distance_[v] - limit;
+				}
+				++augmentations_;
+			}
+			for (auto v : touched)
+			{
+				distance_[v] = inf;
+				previous_[v] = none;
+				settled_[v] = false;
+			}
+		}
+
+		// 把房屋组g从原位置移到节点v（电线杆或"不分配"）
+		void move(size_t g, size_t v)
+		{
+			auto from = nodeOf(g) - map_.groups.size();
+			auto& holders = holders_[from];
+			if (auto it = std::find(holders.begin(), holders.end(), g); it != holders.end())
+			{
+				holders.erase(it);
+			}
+			if (choice_[g] != unassigned)
+			{
+				load_[from] -= weight_[g];
+			}
+			auto to = v - map_.groups.size();
+			holders_[to].push_back(g);
+			if (v == sinkNode())
+			{
+				choice_[g] = unassigned;
+				return;
+			}
+			for (size_t c = 0; c < candidates_[g].size(); ++c)
+			{
+				if (candidates_[g][c].pole == to)
+				{
+					choice_[g] = static_cast<int>(c);
+				}
+			}
+			load_[to] += weight_[g];
+		}
+
+		nlohmann::json result() const
+		{
+			const auto& poles = map_.elec->poles;
+			nlohmann::json j;
+			j["version"] = map_.version;
+
+			double total = 0;
+			auto& groups = j["groups"] = nlohmann::json::array();
+			auto& unassigned = j["unassigned"] = nlohmann::json::array();
+			for (size_t i = 0; i < map_.groups.size(); ++i)
+			{
+				if (choice_[i] < 0)
+				{
+					// 没有有效端点的房屋组本就无需供电
+					const auto& group = map_.groups[i]->group;
+					if (group.group_front_valid || group.group_back_valid)
+					{
+						unassigned.push_back(i);
+					}
+					continue;
+				}
+				const auto& candidate = candidates_[i][choice_[i]];
+				nlohmann::json g;
+				g["index"] = i;
+				g["endpoint"] = candidate.slot == GroupPoint::front_slot ? "front" : "back";
+				g["elec"] = poles[candidate.pole].id;
+				g["distance"] = candidate.distance;
+				groups.push_back(std::move(g));
+				total += candidate.distance;
+			}
+
+			auto& pole_loads = j["poles"] = nlohmann::json::array();
+			for (size_t p = 0; p < poles.size(); ++p)
+			{
+				if (load_[p] > 0)
+				{
+					nlohmann::json pole;
+					pole["id"] = poles[p].id;
+					pole["load"] = load_[p];
+					pole["capacity"] = std::isinf(capacity_[p]) ? nlohmann::json() : nlohmann::json(capacity_[p]);
+					pole_loads.push_back(std::move(pole));
+				}
+			}
+			j["total_distance"] = total;
+			j["exact"] = exact();
+			j["augmentations"] = augmentations_;
+			j["greedy"] = greedy();
+			return j;
+		}
+
+		// 参与分配的房屋组负载都相同时最小费用流的结果最优
+		bool exact() const
+		{
+			std::optional<double> weight;
+			for (size_t i = 0; i < weight_.size(); ++i)
+			{
+				if (candidates_[i].empty())
+				{
+					continue;
+				}
+				if (weight && *weight != weight_[i])
+				{
+					return false;
+				}
+				weight = weight_[i];
+			}
+			return true;
+		}
+
+		// 不考虑容量、每个房屋组取较近的有效端点时的总长和超载电线杆数，用于对比
+		nlohmann::json greedy() const
+		{
+			std::vector<double> load(capacity_.size());
+			double total = 0;
+			for (size_t i = 0; i < map_.groups.size(); ++i)
+			{
+				const auto& entry = *map_.groups[i];
+				const EndpointAssignment* used{};
+				for (const auto* assignment : { &entry.front, &entry.back })
+				{
+					if (assignment->active && (!used || assignment->distance < used->distance))
+					{
+						used = assignment;
+					}
+				}
+				if (used)
+				{
+					total += used->distance;
+					load[map_.elec->by_id.at(used->elec_id)] += weight_[i];
+				}
+			}
+			size_t overloaded = 0;
+			for (size_t p = 0; p < load.size(); ++p)
+			{
+				overloaded += load[p] > capacity_[p] ? 1 : 0;
+			}
+			nlohmann::json j;
+			j["total_distance"] = total;
+			j["overloaded_poles"] = overloaded;
+			return j;
+		}
+
+		static constexpr double inf = std::numeric_limits<double>::infinity();
+		static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+		const MapVersion& map_;
+		CapacityAssignOptions options_;
+		std::vector<double> capacity_;
+		std::vector<double> weight_;
+		std::vector<std::vector<Candidate>> candidates_;
+		double unassigned_cost_{};
+		std::vector<double> load_;
+		std::vector<std::vector<size_t>> holders_;
+		std::vector<int> choice_;
+		std::vector<double> potential_;
+		std::vector<double> distance_;
+		std::vector<size_t> previous_;
+		std::vector<bool> settled_;
+		size_t augmentations_{};
+	};
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include "map_store.h"
+#include "parallel_for.h"
+
+namespace ohtoai {
+	/**
+	 * ChainOrder，房屋组内住户的新顺序
+	 */
+	struct ChainOrder {
+		/**
+		 * 新顺序中每一户在原house_poles中的下标
+		 */
+		std::vector<size_t> order;
+		/**
+		 * 有效组端点到首尾住户的距离加链长，优化前后
+		 */
+		double before{};
+		double after{};
+		/**
+		 * 是否在时间预算内收敛到局部最优
+		 */
+		bool complete{ true };
+
+		bool improved() const
+		{
+			return after < before - 1e-9;
+		}
+	};
+
+	/**
+	 * 用2-opt和Or-opt重排房屋组内的住户，使从组前端点经过所有住户到组后端点的线缆最短。
+	 * 无效的端点不参与计算，即该端可以是任意一户。到达deadline时返回当前最好的顺序
+	 */
+	inline ChainOrder optimizeChain(const HouseGroup& group, std::chrono::steady_clock::time_point deadline)
+	{
+		const auto& houses = group.house_poles;
+		const auto n = houses.size();
+		ChainOrder result;
+		result.order.resize(n);
+		std::iota(result.order.begin(), result.order.end(), 0);
+
+		// path[0]和path[n + 1]为组前、组后端点，其余为住户下标加1
+		std::vector<size_t> path(n + 2);
+		std::iota(path.begin(), path.end(), 0);
+		auto point = [&](size_t node) -> const Hole& {
+			return node == 0 ? group.group_front_pole : node == n + 1 ? group.group_back_pole : houses[node - 1];
+		};
+		auto cost = [&](size_t a, size_t b) {
+			if ((a == 0 || b == 0) && !group.group_front_valid)
+			{
+				return 0.0;
+			}
+			if ((a == n + 1 || b == n + 1) && !group.group_back_valid)
+			{
+				return 0.0;
+			}
+			return ohtoai::distance(point(a), point(b));
+		};
+		auto length = [&]() {
+			double total = 0;
+			for (size_t i = 0; i + 1 < path.size(); ++i)
+			{
+				total += cost(path[i], path[i + 1]);
+			}
+			return total;
+		};
+		result.before = result.after = length();
+		if (n < 2)
+		{
+			return result;
+		}
+
+		constexpr double eps = 1e-9;
+		auto expired = [&]() {
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				result.complete = false;
+			}
+			return !result.complete;
+		};
+		for (auto improved = true; improved && result.complete;)
+		{
+			improved = false;
+			// 2-opt：翻转path[i + 1..j]
+			for (size_t i = 0; i + 2 <= n && !expired(); ++i)
+			{
+				for (auto j = i + 2; j <= n; ++j)
+				{
+					auto delta = cost(path[i], path[j]) + cost(path[i + 1], path[j + 1])
+						- cost(path[i], path[i + 1]) - cost(path[j], path[j + 1]);
+					if (delta < -eps)
+					{
+						std::reverse(path.begin() + i + 1, path.begin() + j + 1);
+						improved = true;
+					}
+				}
+			}
+			// Or-opt：把path[i..i + s - 1]（1到3户）正向或反向移到path[k]和path[k + 1]之间
+			for (size_t s = 1; s <= 3 && s < n; ++s)
+			{
+				for (size_t i = 1; i + s <= n + 1 && !expired(); ++i)
+				{
+					auto first = path[i], last = path[i + s - 1];
+					auto removed = cost(path[i - 1], first) + cost(last, path[i + s]) - cost(path[i - 1], path[i + s]);
+					for (size_t k = 0; k <= n; ++k)
+					{
+						if (k + 1 >= i && k < i + s)
+						{
+							continue;
+						}
+						auto base = cost(path[k], path[k + 1]);
+						auto forward = cost(path[k], first) + cost(last, path[k + 1]) - base;
+						auto backward = cost(path[k], last) + cost(first, path[k + 1]) - base;
+						auto added = std::min(forward, backward);
+						if (added - removed >= -eps)
+						{
+							continue;
+						}
+						std::vector<size_t> segment(path.begin() + i, path.begin() + i + s);
+						if (backward < forward)
+						{
+							std::reverse(segment.begin(), segment.end());
+						}
+						path.erase(path.begin() + i, path.begin() + i + s);
+						auto at = k < i ? k + 1 : k + 1 - s;
+						path.insert(path.begin() + at, segment.begin(), segment.end());
+						improved = true;
+						break;
+					}
+				}
+			}
+		}
+
+		result.after = length();
+		if (result.improved())
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				result.order[i] = path[i + 1] - 1;
+			}
+		}
+		else
+		{
+			result.after = result.before;
+		}
+		return result;
+	}
+
+	/**
+	 * 在总时间预算内并行优化地图中所有房屋组的住户顺序
+	 */
+	inline std::vector<ChainOrder> optimizeChains(const MapVersion& map, std::chrono::milliseconds budget, size_t threads = std::thread::hardware_concurrency())
+	{
+		auto deadline = std::chrono::steady_clock::now() + budget;
+		std::vector<ChainOrder> orders(map.groups.size());
+		parallelFor(map.groups.size(), [&](size_t i) { orders[i] = optimizeChain(map.groups[i]->group, deadline); }, threads, 16);
+		return orders;
+	}
+
+	/**
+	 * 地理坐标地图中按给定顺序经过住户的线缆球面长度（米），与optimizeChain的长度定义相同
+	 */
+	inline double geodesicChainLength(const GeoFrame& geo, const HouseGroup& group, const std::vector<size_t>& order)
+	{
+		std::vector<const Hole*> points;
+		points.reserve(order.size() + 2);
+		if (group.group_front_valid)
+		{
+			points.push_back(&group.group_front_pole);
+		}
+		for (auto i : order)
+		{
+			points.push_back(&group.house_poles[i]);
+		}
+		if (group.group_back_valid)
+		{
+			points.push_back(&group.group_back_pole);
+		}
+		return geo.pathLength(points);
+	}
+
+	/**
+	 * 返回{"version", "length_before", "length_after", "saving", "improved", "incomplete", "groups"}，
+	 * groups只列出变短的房屋组，每项为{"index", "before", "after", "order"}，
+	 * order为新顺序中每一户的原组内下标。incomplete为因时间预算未收敛的房屋组数。
+	 * 地理坐标地图的顺序在投影平面上优化，报告的长度按球面距离（米）重新计算
+	 */
+	inline nlohmann::json chainOrdersToJson(const MapVersion& map, const std::vector<ChainOrder>& orders)
+	{
+		nlohmann::json j;
+		j["version"] = map.version;
+		auto& groups = j["groups"] = nlohmann::json::array();
+		double before = 0, after = 0;
+		size_t incomplete = 0;
+		for (size_t i = 0; i < orders.size(); ++i)
+		{
+			const auto& order = orders[i];
+			auto group_before = order.before, group_after = order.after;
+			if (map.geo)
+			{
+				const auto& group = map.groups[i]->group;
+				std::vector<size_t> original(group.house_poles.size());
+				std::iota(original.begin(), original.end(), 0);
+				group_before = geodesicChainLength(*map.geo, group, original);
+				group_after = order.improved() ? geodesicChainLength(*map.geo, group, order.order) : group_before;
+			}
+			before += group_before;
+			after += group_after;
+			incomplete += order.complete ? 0 : 1;
+			if (order.improved())
+			{
+				nlohmann::json g;
+				g["index"] = i;
+				g["before"] = group_before;
+				g["after"] = group_after;
+				g["order"] = order.order;
+				groups.push_back(std::move(g));
+			}
+		}
+		j["length_before"] = before;
+		j["length_after"] = after;
+		j["saving"] = before - after;
+		j["improved"] = groups.size();
+		j["incomplete"] = incomplete;
+		return j;
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace ohtoai {
+	/**
+	 * 同时阻塞等待的请求数已达上限
+	 */
+	class FeedBusyError : public std::runtime_error {
+	public:
+		explicit FeedBusyError(size_t max_waiters)
+			: std::runtime_error("too many change feed waiters, limit is " + std::to_string(max_waiters))
+		{
+		}
+	};
+
+	/**
+	 * ChangeFeed，记录各地图最近的修改，供客户端按版本增量同步
+	 *
+	 * 每次增量修改记录为一条(基础版本, 新版本, JSON Patch)，整体替换记录为reset。
+	 * 客户端从自己持有的版本出发取后续所有修改；没有新修改时阻塞等待，直到有修改或超时。
+	 * 等待的请求占用服务器的工作线程，同时等待的请求数不超过max_waiters，其余请求始终有空闲的线程。
+	 */
+	class ChangeFeed {
+	public:
+		explicit ChangeFeed(size_t max_entries = 256, size_t max_waiters = 32)
+			: max_entries_{ max_entries ? max_entries : 1 }, max_waiters_{ max_waiters }
+		{
+		}
+
+		// 记录一次增量修改
+		void append(const std::string& name, uint64_t from, uint64_t version, nlohmann::json patch)
+		{
+			{
+				std::lock_guard lock{ mutex_ };
+				auto& log = logs_[name];
+				log.entries.push_back({ from, version, std::move(patch) });
+				if (log.entries.size() > max_entries_)
+				{
+					log.entries.pop_front();
+				}
+				log.version = version;
+			}
+			cv_.notify_all();
+		}
+
+		// 地图被整体替换，此前的修改记录不再有意义
+		void reset(const std::string& name, uint64_t version)
+		{
+			{
+				std::lock_guard lock{ mutex_ };
+				auto& log = logs_[name];
+				log.entries.clear();
+				log.version = version;
+			}
+			cv_.notify_all();
+		}
+
+		/**
+		 * 取since之后的修改，since已是最新版本时最多等待timeout。
+		 * 返回{"version", "changes": [{"from", "version", "patch"}]}；
+		 * since过旧或之后地图被整体替换时changes为空且"reset"为true，客户端应重新获取整个地图。
+		 * 地图不存在时抛出std::out_of_range，需要等待而等待的请求数已达上限时抛出FeedBusyError
+		 */
+		nlohmann::json since(const std::string& name, uint64_t since, std::chrono::milliseconds timeout) const
+		{
+			std::unique_lock lock{ mutex_ };
+			const auto& log = logs_.at(name);
+			if (log.version == since && timeout.count() > 0)
+			{
+				if (waiters_ >= max_waiters_)
+				{
+					throw FeedBusyError(max_waiters_);
+				}
+				++waiters_;
+				cv_.wait_for(lock, timeout, [&log, since] { return log.version != since; });
+				--waiters_;
+			}
+
+			nlohmann::json j;
+			j["version"] = log.version;
+			j["changes"] = nlohmann::json::array();
+			if (log.version == since)
+			{
+				return j;
+			}
+			auto it = std::find_if(log.entries.begin(), log.entries.end(), [since](const Entry& e) { return e.from == since; });
+			if (it == log.entries.end())
+			{
+				j["reset"] = true;
+				return j;
+			}
+			for (; it != log.entries.end(); ++it)
+			{
+				nlohmann::json change;
+				change["from"] = it->from;
+				change["version"] = it->version;
+				change["patch"] = it->patch;
+				j["changes"].push_back(std::move(change));
+			}
+			return j;
+		}
+
+	private:
+		struct Entry {
+			uint64_t from;
+			uint64_t version;
+			nlohmann::json patch;
+		};
+
+		struct Log {
+			uint64_t version{};
+			std::deque<Entry> entries;
+		};
+
+		size_t max_entries_;
+		size_t max_waiters_;
+		mutable size_t waiters_{};
+		mutable std::mutex mutex_;
+		mutable std::condition_variable cv_;
+		std::map<std::string, Log> logs_;
+	};
+}
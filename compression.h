@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <cpp-httplib/httplib.h>
+
+namespace ohtoai {
+	/**
+	 * ContentEncoding，响应体的压缩方式。项目定义了CPPHTTPLIB_ZLIB_SUPPORT并通过vcpkg链接zlib，gzip总是可用；
+	 * br需要另外定义CPPHTTPLIB_BROTLI_SUPPORT并链接brotli
+	 */
+	enum class ContentEncoding : unsigned {
+		identity,
+		gzip,
+		br,
+	};
+
+	inline const char* encodingName(ContentEncoding encoding)
+	{
+		switch (encoding)
+		{
+		case ContentEncoding::gzip: return "gzip";
+		case ContentEncoding::br: return "br";
+		default: return "identity";
+		}
+	}
+
+	// 按Accept-Encoding头选择压缩方式，只考虑已启用的方式。未列出的方式取"*"的q值，没有"*"时不可用；
+	// identity未列出且没有"*"时可用但不优先。q值最高者优先，相同时依次优先br、gzip、identity。
+	// 没有可用的方式时（例如"identity;q=0"而压缩方式都未列出）仍返回identity，由不压缩的响应兜底
+	inline ContentEncoding negotiateEncoding(const std::string& accept_encoding)
+	{
+		std::optional<double> wildcard, identity, gzip, br;
+		size_t start = 0;
+		while (start <= accept_encoding.size())
+		{
+			auto end = std::min(accept_encoding.find(',', start), accept_encoding.size());
+			auto item = accept_encoding.substr(start, end - start);
+			start = end + 1;
+
+			auto name_end = item.find(';');
+			auto name = item.substr(0, name_end);
+			name.erase(0, name.find_first_not_of(" \t"));
+			name.erase(name.find_last_not_of(" \t") + 1);
+			std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			auto q = 1.0;
+			if (auto pos = item.find("q=", name_end == std::string::npos ? item.size() : name_end); pos != std::string::npos)
+			{
+				q = std::clamp(std::atof(item.c_str() + pos + 2), 0.0, 1.0);
+			}
+
+			auto* target = name == "*" ? &wildcard : name == "identity" ? &identity : name == "gzip" ? &gzip : name == "br" ? &br : nullptr;
+			if (target && !*target)
+			{
+				*target = q;
+			}
+		}
+
+		auto best = ContentEncoding::identity;
+		auto best_q = identity.value_or(wildcard.value_or(0.0));
+		auto consider = [&](ContentEncoding encoding, const std::optional<double>& listed) {
+			auto q = listed.value_or(wildcard.value_or(0.0));
+			if (q > 0 && (q > best_q || (q == best_q && best == ContentEncoding::identity)))
+			{
+				best = encoding;
+				best_q = q;
+			}
+		};
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+		consider(ContentEncoding::br, br);
+#endif
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+		consider(ContentEncoding::gzip, gzip);
+#endif
+		return best;
+	}
+
+	// 压缩整个响应体，失败时抛出std::runtime_error
+	inline std::string compress(const std::string& body, ContentEncoding encoding)
+	{
+		std::unique_ptr<httplib::detail::compressor> compressor;
+		switch (encoding)
+		{
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+		case ContentEncoding::gzip:
+			compressor = std::make_unique<httplib::detail::gzip_compressor>();
+			break;
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+		case ContentEncoding::br:
+			compressor = std::make_unique<httplib::detail::brotli_compressor>();
+			break;
+#endif
+		default:
+			return body;
+		}
+
+		std::string out;
+		auto ok = compressor->compress(body.data(), body.size(), true, [&out](const char* data, size_t length) {
+			out.append(data, length);
+			return true;
+			});
+		if (!ok)
+		{
+			throw std::runtime_error(std::string("cannot compress response with ") + encodingName(encoding));
+		}
+		return out;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "elec_hole.h"
+
+namespace ohtoai {
+	/**
+	 * 欧氏距离，与ohtoai::distance相同
+	 */
+	struct EuclideanMetric {
+		static constexpr const char* name = "euclidean";
+		/**
+		 * 与地图预先计算的链长前缀和、端点分配使用同一度量，可以直接复用
+		 */
+		static constexpr bool euclidean = true;
+
+		static double length(double dx, double dy)
+		{
+			return std::sqrt(dx * dx + dy * dy);
+		}
+	};
+
+	/**
+	 * 曼哈顿距离，沿街道网格布线
+	 */
+	struct ManhattanMetric {
+		static constexpr const char* name = "manhattan";
+		static constexpr bool euclidean = false;
+
+		static double length(double dx, double dy)
+		{
+			return std::abs(dx) + std::abs(dy);
+		}
+	};
+
+	/**
+	 * CostModel，线缆费用模型：度量作为模板参数在编译期展开，
+	 * 费用为price乘线缆长度，加上每个供电端点接到电线杆的固定费用connection。
+	 * 默认的欧氏度量、price为1、connection为0时费用等于线缆长度。
+	 * 度量不能小于欧氏距离，度量半径r内的点都在欧氏距离r内，按此在空间索引中查找最近的电线杆
+	 */
+	template <class Metric>
+	struct CostModel {
+		using metric_type = Metric;
+
+		double price{ 1.0 };
+		double connection{ 0.0 };
+
+		double length(double dx, double dy) const
+		{
+			return Metric::length(dx, dy);
+		}
+
+		double length(const Hole& a, const Hole& b) const
+		{
+			return length(a.x - b.x, a.y - b.y);
+		}
+
+		/**
+		 * 长度为length的线缆由组前、组后端点中的哪几个供电时的费用
+		 */
+		double cost(double length, bool front, bool back) const
+		{
+			return price * length + (front ? connection : 0.0) + (back ? connection : 0.0);
+		}
+	};
+
+	/**
+	 * 由查询参数选择内置的费用模型并调用fn(CostModel<Metric>)：
+	 * cost为euclidean（默认）或manhattan，price和connection为空时取默认值。
+	 * 未知的名称或负的价格抛出std::invalid_argument
+	 */
+	template <class Fn>
+	decltype(auto) withCostModel(const std::string& cost, const std::string& price, const std::string& connection, Fn&& fn)
+	{
+		auto configure = [&](auto model) {
+			if (!price.empty())
+			{
+				model.price = std::stod(price);
+			}
+			if (!connection.empty())
+			{
+				model.connection = std::stod(connection);
+			}
+			if (!(model.price >= 0) || !(model.connection >= 0))
+			{
+				throw std::invalid_argument("price and connection must be non-negative");
+			}
+			return model;
+		};
+		if (cost.empty() || cost == EuclideanMetric::name)
+		{
+			return fn(configure(CostModel<EuclideanMetric>{}));
+		}
+		if (cost == ManhattanMetric::name)
+		{
+			return fn(configure(CostModel<ManhattanMetric>{}));
+		}
+		throw std::invalid_argument("unknown cost model: " + cost);
+	}
+}
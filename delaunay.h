@@ -0,0 +1,623 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace ohtoai {
+	/**
+	 * Delaunay，平面点集的Delaunay三角剖分（扫描凸包算法，期望O(n log n)）
+	 *
+	 * 点按到种子三角形外心的距离依次加入，用角度哈希在凸包上定位可见边，
+	 * 加入后以边翻转恢复Delaunay性质。结果以半边表示：
+	 * triangles[e]为半边e的起点，halfedges[e]为相邻三角形中的对边，没有时为none；
+	 * 三角形t由半边3t、3t+1、3t+2组成，y轴向上时为顺时针。
+	 * 凸包行走依赖的方向判断先用浮点误差界过滤，判断不了时精确计算，
+	 * 因此共线和近似共线的点不会破坏拓扑；空圆判断只影响近似共圆时选哪条对角线。
+	 * 重复点不进入三角剖分；全部共线时没有三角形，hull按直线顺序给出。
+	 */
+	class Delaunay {
+	public:
+		static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+		Delaunay() = default;
+
+		// coords为x0, y0, x1, y1, ...
+		explicit Delaunay(std::vector<double> coords) : coords_{ std::move(coords) }
+		{
+			if (coords_.size() % 2 != 0)
+			{
+				throw std::invalid_argument("delaunay coords must come in pairs");
+			}
+			triangulate();
+		}
+
+		size_t pointCount() const
+		{
+			return coords_.size() / 2;
+		}
+
+		double x(size_t i) const { return coords_[2 * i]; }
+		double y(size_t i) const { return coords_[2 * i + 1]; }
+
+		const std::vector<size_t>& triangles() const
+		{
+			return triangles_;
+		}
+
+		const std::vector<size_t>& halfedges() const
+		{
+			return halfedges_;
+		}
+
+		// 凸包顶点，y轴向上时为顺时针
+		const std::vector<size_t>& hull() const
+		{
+			return hull_;
+		}
+
+		static size_t nextHalfedge(size_t e)
+		{
+			return e % 3 == 2 ? e - 2 : e + 1;
+		}
+
+		static size_t prevHalfedge(size_t e)
+		{
+			return e % 3 == 0 ? e + 2 : e - 1;
+		}
+
+		// 遍历每条无向边一次：fn(a, b)。全部共线时为直线上相邻的两点
+		template <typename Fn>
+		void forEachEdge(Fn&& fn) const
+		{
+			if (triangles_.empty())
+			{
+				for (size_t k = 1; k < hull_.size(); ++k)
+				{
+					fn(hull_[k - 1], hull_[k]);
+				}
+				return;
+			}
+			for (size_t e = 0; e < triangles_.size(); ++e)
+			{
+				if (halfedges_[e] == none || e > halfedges_[e])
+				{
+					fn(triangles_[e], triangles_[nextHalfedge(e)]);
+				}
+			}
+		}
+
+		// 三角形t的外心
+		std::pair<double, double> circumcenter(size_t t) const
+		{
+			auto a = triangles_[3 * t], b = triangles_[3 * t + 1], c = triangles_[3 * t + 2];
+			return circumcenter(x(a), y(a), x(b), y(b), x(c), y(c));
+		}
+
+		/**
+		 * 若插入点(x, y)，它在新三角剖分中的邻点（即Voronoi单元会被它分走一部分的点），升序。
+		 * nearest为离(x, y)最近的点。从nearest周围和(x, y)可见的凸包边出发，
+		 * 广度优先找出外接圆包含(x, y)的三角形（冲突区域），其顶点与可见凸包边的端点即为邻点。
+		 * 没有三角形时返回所有点
+		 */
+		std::vector<size_t> insertionNeighbors(double px, double py, size_t nearest) const
+		{
+			std::vector<size_t> result;
+			if (triangles_.empty())
+			{
+				result = hull_;
+				std::sort(result.begin(), result.end());
+				return result;
+			}
+
+			std::vector<size_t> queue;
+			std::vector<bool> seen(triangles_.size() / 3);
+			auto visit = [&](size_t t) {
+				if (seen[t])
+				{
+					return;
+				}
+				seen[t] = true;
+				auto a = triangles_[3 * t], b = triangles_[3 * t + 1], c = triangles_[3 * t + 2];
+				if (inCircle(x(a), y(a), x(b), y(b), x(c), y(c), px, py))
+				{
+					queue.push_back(t);
+				}
+			};
+			if (nearest < inedges_.size() && inedges_[nearest] != none)
+			{
+				auto start = inedges_[nearest];
+				auto incoming = start;
+				do
+				{
+					visit(incoming / 3);
+					incoming = halfedges_[nextHalfedge(incoming)];
+				} while (incoming != none && incoming != start);
+				result.push_back(nearest);
+			}
+			// 凸包为顺时针，点在凸包边左侧即在凸包外且看得见这条边
+			for (size_t k = 0; k < hull_.size(); ++k)
+			{
+				auto a = hull_[k], b = hull_[(k + 1) % hull_.size()];
+				if (orient(x(a), y(a), x(b), y(b), px, py))
+				{
+					result.push_back(a);
+					result.push_back(b);
+					visit(inedges_[b] / 3);
+				}
+			}
+			for (size_t head = 0; head < queue.size(); ++head)
+			{
+				auto t = queue[head];
+				for (size_t e = 3 * t; e < 3 * t + 3; ++e)
+				{
+					result.push_back(triangles_[e]);
+					if (halfedges_[e] != none)
+					{
+						visit(halfedges_[e] / 3);
+					}
+				}
+			}
+			std::sort(result.begin(), result.end());
+			result.erase(std::unique(result.begin(), result.end()), result.end());
+			return result;
+		}
+
+		static std::pair<double, double> circumcenter(double ax, double ay, double bx, double by, double cx, double cy)
+		{
+			auto dx = bx - ax, dy = by - ay;
+			auto ex = cx - ax, ey = cy - ay;
+			auto bl = dx * dx + dy * dy;
+			auto cl = ex * ex + ey * ey;
+			auto d = 0.5 / (dx * ey - dy * ex);
+			return { ax + (ey * bl - dy * cl) * d, ay + (dx * cl - ex * bl) * d };
+		}
+
+	private:
+		// p、q、r为逆时针（y轴向上）
+		static bool orient(double px, double py, double qx, double qy, double rx, double ry)
+		{
+			return orient2d(px, py, qx, qy, rx, ry) > 0;
+		}
+
+		// (q - p)×(r - p)，返回值的符号是精确的
+		static double orient2d(double px, double py, double qx, double qy, double rx, double ry)
+		{
+			auto left = (qx - px) * (ry - py);
+			auto right = (qy - py) * (rx - px);
+			auto det = left - right;
+			// Shewchuk的误差界：超过它时浮点结果的符号可信
+			constexpr auto eps = std::numeric_limits<double>::epsilon() / 2;
+			auto bound = (3 + 16 * eps) * eps * (std::abs(left) + std::abs(right));
+			if (det > bound || -det > bound)
+			{
+				return det;
+			}
+			return orient2dExact(px, py, qx, qy, rx, ry);
+		}
+
+		// 展开为六个乘积之和，每个乘积用fma拆成两个double，再以无重叠展开式精确求和
+		static double orient2dExact(double px, double py, double qx, double qy, double rx, double ry)
+		{
+			double expansion[12];
+			size_t size = 0;
+			auto add = [&expansion, &size](double b) {
+				size_t kept = 0;
+				for (size_t i = 0; i < size; ++i)
+				{
+					auto sum = b + expansion[i];
+					auto bv = sum - b;
+					auto error = (b - (sum - bv)) + (expansion[i] - bv);
+					if (error != 0)
+					{
+						expansion[kept++] = error;
+					}
+					b = sum;
+				}
+				if (b != 0)
+				{
+					expansion[kept++] = b;
+				}
+				size = kept;
+			};
+			auto product = [&add](double a, double b) {
+				auto high = a * b;
+				add(high);
+				add(std::fma(a, b, -high));
+			};
+			product(qx, ry);
+			product(-qx, py);
+			product(-px, ry);
+			product(-qy, rx);
+			product(qy, px);
+			product(py, rx);
+			// 展开式按绝对值递增，最后一项决定符号
+			return size == 0 ? 0 : expansion[size - 1];
+		}
+
+		static double circumradius2(double ax, double ay, double bx, double by, double cx, double cy)
+		{
+			auto dx = bx - ax, dy = by - ay;
+			auto ex = cx - ax, ey = cy - ay;
+			auto bl = dx * dx + dy * dy;
+			auto cl = ex * ex + ey * ey;
+			auto d = dx * ey - dy * ex;
+			if (bl == 0 || cl == 0 || d == 0)
+			{
+				return std::numeric_limits<double>::infinity();
+			}
+			auto rx = (ey * bl - dy * cl) * 0.5 / d;
+			auto ry = (dx * cl - ex * bl) * 0.5 / d;
+			return rx * rx + ry * ry;
+		}
+
+		static bool inCircle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+		{
+			auto dx = ax - px, dy = ay - py;
+			auto ex = bx - px, ey = by - py;
+			auto fx = cx - px, fy = cy - py;
+			auto ap = dx * dx + dy * dy;
+			auto bp = ex * ex + ey * ey;
+			auto cp = fx * fx + fy * fy;
+			return dx * (ey * cp - bp * fy) - dy * (ex * cp - bp * fx) + ap * (ex * fy - ey * fx) < 0;
+		}
+
+		// 点相对外心的伪角度，取值[0, 1)，单调对应极角
+		size_t hashKey(double px, double py) const
+		{
+			auto dx = px - cx_, dy = py - cy_;
+			auto sum = std::abs(dx) + std::abs(dy);
+			auto p = sum == 0 ? 0 : dx / sum;
+			auto angle = (dy > 0 ? 3 - p : 1 + p) / 4;
+			return static_cast<size_t>(std::floor(angle * static_cast<double>(hash_size_))) % hash_size_;
+		}
+
+		void triangulate()
+		{
+			auto n = pointCount();
+			if (n == 0)
+			{
+				return;
+			}
+
+			auto min_x = std::numeric_limits<double>::infinity(), min_y = min_x;
+			auto max_x = -min_x, max_y = -min_x;
+			for (size_t i = 0; i < n; ++i)
+			{
+				min_x = std::min(min_x, x(i));
+				min_y = std::min(min_y, y(i));
+				max_x = std::max(max_x, x(i));
+				max_y = std::max(max_y, y(i));
+			}
+			auto center_x = (min_x + max_x) / 2, center_y = (min_y + max_y) / 2;
+
+			// 种子三角形：离中心最近的点、离它最近的点、与两者外接圆最小的点
+			auto dist2 = [this](size_t i, double px, double py) {
+				auto dx = x(i) - px, dy = y(i) - py;
+				return dx * dx + dy * dy;
+			};
+			size_t i0 = 0, i1 = none, i2 = none;
+			for (size_t i = 1; i < n; ++i)
+			{
+				if (dist2(i, center_x, center_y) < dist2(i0, center_x, center_y))
+				{
+					i0 = i;
+				}
+			}
+			auto best = std::numeric_limits<double>::infinity();
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto d = dist2(i, x(i0), y(i0));
+				if (i != i0 && d > 0 && d < best)
+				{
+					i1 = i;
+					best = d;
+				}
+			}
+			best = std::numeric_limits<double>::infinity();
+			if (i1 != none)
+			{
+				for (size_t i = 0; i < n; ++i)
+				{
+					if (i == i0 || i == i1)
+					{
+						continue;
+					}
+					auto r = circumradius2(x(i0), y(i0), x(i1), y(i1), x(i), y(i));
+					if (r < best)
+					{
+						i2 = i;
+						best = r;
+					}
+				}
+			}
+
+			if (i2 == none)
+			{
+				// 全部共线或重复：按到第一个点的距离排序给出凸包
+				std::vector<double> dists(n);
+				std::vector<size_t> ids(n);
+				std::iota(ids.begin(), ids.end(), 0);
+				for (size_t i = 0; i < n; ++i)
+				{
+					dists[i] = (x(i) - x(0)) != 0 ? x(i) - x(0) : y(i) - y(0);
+				}
+				std::sort(ids.begin(), ids.end(), [&dists](size_t a, size_t b) { return dists[a] < dists[b]; });
+				auto last = -std::numeric_limits<double>::infinity();
+				for (auto i : ids)
+				{
+					if (dists[i] > last)
+					{
+						hull_.push_back(i);
+						last = dists[i];
+					}
+				}
+				return;
+			}
+
+			if (orient(x(i0), y(i0), x(i1), y(i1), x(i2), y(i2)))
+			{
+				std::swap(i1, i2);
+			}
+			std::tie(cx_, cy_) = circumcenter(x(i0), y(i0), x(i1), y(i1), x(i2), y(i2));
+
+			// 按到外心的距离排序
+			std::vector<double> dists(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				dists[i] = dist2(i, cx_, cy_);
+			}
+			std::vector<size_t> ids(n);
+			std::iota(ids.begin(), ids.end(), 0);
+			std::sort(ids.begin(), ids.end(), [&dists](size_t a, size_t b) { return dists[a] < dists[b]; });
+
+			hash_size_ = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(n))));
+			hull_prev_.assign(n, none);
+			hull_next_.assign(n, none);
+			hull_tri_.assign(n, none);
+			hull_hash_.assign(hash_size_, none);
+
+			hull_start_ = i0;
+			hull_next_[i0] = hull_prev_[i2] = i1;
+			hull_next_[i1] = hull_prev_[i0] = i2;
+			hull_next_[i2] = hull_prev_[i1] = i0;
+			hull_tri_[i0] = 0;
+			hull_tri_[i1] = 1;
+			hull_tri_[i2] = 2;
+			hull_hash_[hashKey(x(i0), y(i0))] = i0;
+			hull_hash_[hashKey(x(i1), y(i1))] = i1;
+			hull_hash_[hashKey(x(i2), y(i2))] = i2;
+
+			auto max_triangles = n < 3 ? 1 : 2 * n - 5;
+			triangles_.reserve(max_triangles * 3);
+			halfedges_.reserve(max_triangles * 3);
+			addTriangle(i0, i1, i2, none, none, none);
+
+			auto prev_x = std::numeric_limits<double>::quiet_NaN(), prev_y = prev_x;
+			for (size_t k = 0; k < n; ++k)
+			{
+				auto i = ids[k];
+				auto px = x(i), py = y(i);
+				// 跳过与前一点重合的点和种子点
+				if (k > 0 && std::abs(px - prev_x) <= epsilon && std::abs(py - prev_y) <= epsilon)
+				{
+					continue;
+				}
+				prev_x = px;
+				prev_y = py;
+				if (i == i0 || i == i1 || i == i2)
+				{
+					continue;
+				}
+
+				// 在凸包上找到一条对该点可见的边
+				size_t start = 0;
+				for (size_t j = 0, key = hashKey(px, py); j < hash_size_; ++j)
+				{
+					start = hull_hash_[(key + j) % hash_size_];
+					if (start != none && start != hull_next_[start])
+					{
+						break;
+					}
+				}
+				start = hull_prev_[start];
+				auto e = start;
+				size_t q;
+				while (q = hull_next_[e], !orient(px, py, x(e), y(e), x(q), y(q)))
+				{
+					e = q;
+					if (e == start)
+					{
+						e = none;
+						break;
+					}
+				}
+				// 与已有点几乎重合，跳过
+				if (e == none)
+				{
+					continue;
+				}
+
+				auto t = addTriangle(e, i, hull_next_[e], none, none, hull_tri_[e]);
+				hull_tri_[i] = legalize(t + 2);
+				hull_tri_[e] = t;
+
+				// 向前走，加入可见边形成的三角形
+				auto next = hull_next_[e];
+				while (q = hull_next_[next], orient(px, py, x(next), y(next), x(q), y(q)))
+				{
+					t = addTriangle(next, i, q, hull_tri_[i], none, hull_tri_[next]);
+					hull_tri_[i] = legalize(t + 2);
+					hull_next_[next] = next;
+					next = q;
+				}
+				// 向后走
+				if (e == start)
+				{
+					while (q = hull_prev_[e], orient(px, py, x(q), y(q), x(e), y(e)))
+					{
+						t = addTriangle(q, i, e, none, hull_tri_[e], hull_tri_[q]);
+						legalize(t + 2);
+						hull_tri_[q] = t;
+						hull_next_[e] = e;
+						e = q;
+					}
+				}
+
+				hull_start_ = hull_prev_[i] = e;
+				hull_next_[e] = hull_prev_[next] = i;
+				hull_next_[i] = next;
+				hull_hash_[hashKey(px, py)] = i;
+				hull_hash_[hashKey(x(e), y(e))] = e;
+			}
+
+			for (auto e = hull_start_;;)
+			{
+				hull_.push_back(e);
+				e = hull_next_[e];
+				if (e == hull_start_)
+				{
+					break;
+				}
+			}
+			triangles_.shrink_to_fit();
+			halfedges_.shrink_to_fit();
+			// 凸包上的点优先取凸包边，从它出发绕点一周不会中断
+			inedges_.assign(n, none);
+			for (size_t e = 0; e < triangles_.size(); ++e)
+			{
+				auto p = triangles_[nextHalfedge(e)];
+				if (halfedges_[e] == none || inedges_[p] == none)
+				{
+					inedges_[p] = e;
+				}
+			}
+			hull_prev_ = {};
+			hull_next_ = {};
+			hull_tri_ = {};
+			hull_hash_ = {};
+			edge_stack_ = {};
+		}
+
+		void link(size_t a, size_t b)
+		{
+			halfedges_[a] = b;
+			if (b != none)
+			{
+				halfedges_[b] = a;
+			}
+		}
+
+		size_t addTriangle(size_t i0, size_t i1, size_t i2, size_t a, size_t b, size_t c)
+		{
+			auto t = triangles_.size();
+			triangles_.push_back(i0);
+			triangles_.push_back(i1);
+			triangles_.push_back(i2);
+			halfedges_.resize(t + 3, none);
+			link(t, a);
+			link(t + 1, b);
+			link(t + 2, c);
+			return t;
+		}
+
+		// 递归地翻转不满足空圆性质的边，返回与新点相对的半边
+		size_t legalize(size_t a)
+		{
+			size_t depth = 0;
+			size_t ar = 0;
+			for (;;)
+			{
+				auto b = halfedges_[a];
+				auto a0 = a - a % 3;
+				ar = a0 + (a + 2) % 3;
+
+				if (b == none)
+				{
+					if (depth == 0)
+					{
+						break;
+					}
+					a = edge_stack_[--depth];
+					continue;
+				}
+
+				auto b0 = b - b % 3;
+				auto al = a0 + (a + 1) % 3;
+				auto bl = b0 + (b + 2) % 3;
+				auto p0 = triangles_[ar];
+				auto pr = triangles_[a];
+				auto pl = triangles_[al];
+				auto p1 = triangles_[bl];
+
+				if (!inCircle(x(p0), y(p0), x(pr), y(pr), x(pl), y(pl), x(p1), y(p1)))
+				{
+					if (depth == 0)
+					{
+						break;
+					}
+					a = edge_stack_[--depth];
+					continue;
+				}
+
+				triangles_[a] = p1;
+				triangles_[b] = p0;
+				auto hbl = halfedges_[bl];
+				// 翻转的边在凸包上时修正凸包记录的三角形
+				if (hbl == none)
+				{
+					auto e = hull_start_;
+					do
+					{
+						if (hull_tri_[e] == bl)
+						{
+							hull_tri_[e] = a;
+							break;
+						}
+						e = hull_prev_[e];
+					} while (e != hull_start_);
+				}
+				link(a, hbl);
+				link(b, halfedges_[ar]);
+				link(ar, bl);
+
+				auto br = b0 + (b + 1) % 3;
+				if (depth < edge_stack_.size())
+				{
+					edge_stack_[depth] = br;
+				}
+				else
+				{
+					edge_stack_.push_back(br);
+				}
+				++depth;
+			}
+			return ar;
+		}
+
+		static constexpr double epsilon = 1e-12;
+
+		std::vector<double> coords_;
+		std::vector<size_t> triangles_;
+		std::vector<size_t> halfedges_;
+		std::vector<size_t> hull_;
+		/**
+		 * 以该点为终点的一条半边，不在三角剖分中的点为none
+		 */
+		std::vector<size_t> inedges_;
+
+		// 构建过程中的临时数据
+		double cx_{}, cy_{};
+		size_t hash_size_{};
+		size_t hull_start_{};
+		std::vector<size_t> hull_prev_;
+		std::vector<size_t> hull_next_;
+		std::vector<size_t> hull_tri_;
+		std::vector<size_t> hull_hash_;
+		std::vector<size_t> edge_stack_;
+	};
+}
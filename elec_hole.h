@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <cmath>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 
 namespace ohtoai {
@@ -30,7 +32,23 @@ namespace ohtoai {
         double y;
         nlohmann::json extra;
 
-        NLOHMANN_DEFINE_TYPE_INTRUSIVE(Hole, id, x, y, extra);
+        friend void to_json(nlohmann::json& j, const Hole& h)
+        {
+            j = nlohmann::json{ { "id", h.id }, { "x", h.x }, { "y", h.y }, { "extra", h.extra } };
+        }
+
+        // 坐标必须是有限值：NaN和无穷大会使空间索引无法确定范围，MessagePack、CBOR、BSON都可以携带
+        friend void from_json(const nlohmann::json& j, Hole& h)
+        {
+            j.at("id").get_to(h.id);
+            j.at("x").get_to(h.x);
+            j.at("y").get_to(h.y);
+            j.at("extra").get_to(h.extra);
+            if (!std::isfinite(h.x) || !std::isfinite(h.y))
+            {
+                throw std::invalid_argument("non-finite coordinate of hole: " + h.id);
+            }
+        }
     };
 
     /**
@@ -81,4 +99,10 @@ namespace ohtoai {
 		Hole elec_pole;
         NLOHMANN_DEFINE_TYPE_INTRUSIVE(LayoutSolution, distance, path, house_endpoint_pole, elec_pole);
     };
+
+    inline double distance(const Hole& h1, const Hole& h2)
+    {
+        auto dx = h1.x - h2.x, dy = h1.y - h2.y;
+        return std::sqrt(dx * dx + dy * dy);
+    }
 }
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "elec_hole.h"
+
+namespace ohtoai {
+	/**
+	 * GeoFrame，地理坐标地图的局部平面坐标系
+	 *
+	 * 地理坐标地图中Hole的x为经度、y为纬度（WGS84，度）。导入时一次性投影到以origin为原点的
+	 * 球面切平面（ENU，东、北，米），地图版本中保存的都是平面坐标，索引、三角剖分和各算法与平面地图完全相同。
+	 * 正射投影把离原点球面距离为s的点放在半径R·sin(s / R)处：到原点的距离偏短约(s / R)^2 / 6，
+	 * 沿径向的局部长度缩短约(s / R)^2 / 2，切向没有误差。误差随s增长且没有上界，s达到四分之一圆周后投影折叠，
+	 * 因此点到原点的球面距离不能超过max_extent（500千米，径向局部误差小于0.31%，10千米内小于1.3e-6），
+	 * 经纬度越界或超出该范围的点在导入和修改时拒绝。
+	 * 返回给调用方的坐标再反投影回经纬度，最终报告的长度用haversine公式按球面距离重新计算。
+	 */
+	class GeoFrame {
+	public:
+		/**
+		 * 地球平均半径（米）
+		 */
+		static constexpr double earth_radius = 6371008.8;
+		static constexpr const char* crs = "wgs84";
+		/**
+		 * 点到原点的最大球面距离（米）
+		 */
+		static constexpr double max_extent = 500e3;
+
+		GeoFrame(double lon, double lat)
+			: lon0_{ lon }, lat0_{ lat }
+		{
+			if (!(lat >= -90 && lat <= 90) || !std::isfinite(lon))
+			{
+				throw std::invalid_argument("invalid geographic origin");
+			}
+			sin_lat0_ = std::sin(radians(lat));
+			cos_lat0_ = std::cos(radians(lat));
+			cos_max_angle_ = std::cos(max_extent / earth_radius);
+		}
+
+		/**
+		 * 由地图json的"crs"和"origin"构造：crs缺省或为"planar"时返回空，
+		 * 为"wgs84"时origin为{"lon", "lat"}，缺省时取地图中所有点经纬度包围盒的中心
+		 */
+		static std::shared_ptr<const GeoFrame> fromJson(const nlohmann::json& j, const MapInfo& map)
+		{
+			auto name = j.is_object() ? j.value("crs", std::string{ "planar" }) : std::string{ "planar" };
+			if (name == "planar")
+			{
+				return nullptr;
+			}
+			if (name != crs)
+			{
+				throw std::invalid_argument("unknown crs: " + name);
+			}
+			if (j.contains("origin"))
+			{
+				const auto& origin = j.at("origin");
+				return std::make_shared<const GeoFrame>(origin.at("lon").get<double>(), origin.at("lat").get<double>());
+			}
+			bool any = false;
+			double min_lon = 0, max_lon = 0, min_lat = 0, max_lat = 0;
+			auto visit = [&](const Hole& h) {
+				min_lon = any ? std::min(min_lon, h.x) : h.x;
+				max_lon = any ? std::max(max_lon, h.x) : h.x;
+				min_lat = any ? std::min(min_lat, h.y) : h.y;
+				max_lat = any ? std::max(max_lat, h.y) : h.y;
+				any = true;
+			};
+			for (const auto& pole : map.elec_poles)
+			{
+				visit(pole);
+			}
+			for (const auto& group : map.house_groups)
+			{
+				visit(group.group_front_pole);
+				visit(group.group_back_pole);
+				for (const auto& hp : group.house_poles)
+				{
+					visit(hp);
+				}
+			}
+			return std::make_shared<const GeoFrame>((min_lon + max_lon) / 2, (min_lat + max_lat) / 2);
+		}
+
+		nlohmann::json toJson() const
+		{
+			nlohmann::json j;
+			j["crs"] = crs;
+			j["origin"] = { { "lon", lon0_ }, { "lat", lat0_ } };
+			return j;
+		}
+
+		// 经纬度投影为切平面坐标，经纬度越界或离原点超过max_extent时抛出std::invalid_argument
+		std::pair<double, double> project(double lon, double lat) const
+		{
+			if (!(lat >= -90 && lat <= 90) || !(lon >= -180 && lon <= 180))
+			{
+				throw std::invalid_argument("longitude or latitude out of range: " + std::to_string(lon) + ", " + std::to_string(lat));
+			}
+			auto [east, north, cos_angle] = tangent(lon, lat);
+			if (cos_angle < cos_max_angle_)
+			{
+				throw std::invalid_argument("point " + std::to_string(lon) + ", " + std::to_string(lat) + " is more than "
+					+ std::to_string(static_cast<int>(max_extent / 1000)) + " km from the map origin");
+			}
+			return { east, north };
+		}
+
+		// 切平面坐标反投影为经纬度，保留到1e-9度（约0.1毫米），使导入的坐标原样返回
+		std::pair<double, double> unproject(double east, double north) const
+		{
+			auto up = std::sqrt(std::max(0.0, earth_radius * earth_radius - east * east - north * north));
+			auto x = up * cos_lat0_ - north * sin_lat0_;
+			auto z = north * cos_lat0_ + up * sin_lat0_;
+			auto lon = lon0_ + degrees(std::atan2(east, x));
+			auto lat = degrees(std::atan2(z, std::hypot(east, x)));
+			lon = lon > 180 ? lon - 360 : lon < -180 ? lon + 360 : lon;
+			return { round(lon), round(lat) };
+		}
+
+		/**
+		 * 经纬度矩形投影后的外接矩形{min_x, min_y, max_x, max_y}：沿四条边取样投影，
+		 * 再向外扩展0.1%，覆盖样点之间边界的弯曲
+		 */
+		std::array<double, 4> planarBox(double min_lon, double min_lat, double max_lon, double max_lat) const
+		{
+			constexpr int samples = 16;
+			auto inf = std::numeric_limits<double>::infinity();
+			std::array<double, 4> box{ inf, inf, -inf, -inf };
+			auto extend = [&](double lon, double lat) {
+				auto [x, y, cos_angle] = tangent(lon, lat);
+				box = { std::min(box[0], x), std::min(box[1], y), std::max(box[2], x), std::max(box[3], y) };
+			};
+			for (int k = 0; k <= samples; ++k)
+			{
+				auto lon = min_lon + (max_lon - min_lon) * k / samples;
+				auto lat = min_lat + (max_lat - min_lat) * k / samples;
+				extend(lon, min_lat);
+				extend(lon, max_lat);
+				extend(min_lon, lat);
+				extend(max_lon, lat);
+			}
+			auto margin = std::max(box[2] - box[0], box[3] - box[1]) * 1e-3;
+			return { box[0] - margin, box[1] - margin, box[2] + margin, box[3] + margin };
+		}
+
+		/**
+		 * 平面坐标点反投影后是否落在经纬度矩形中，配合planarBox在索引中查找后精确筛选
+		 */
+		bool inside(double x, double y, double min_lon, double min_lat, double max_lon, double max_lat) const
+		{
+			auto [lon, lat] = unproject(x, y);
+			return lon >= min_lon && lon <= max_lon && lat >= min_lat && lat <= max_lat;
+		}
+
+		void toPlanar(Hole& h) const
+		{
+			std::tie(h.x, h.y) = project(h.x, h.y);
+		}
+
+		void toGeographic(Hole& h) const
+		{
+			std::tie(h.x, h.y) = unproject(h.x, h.y);
+		}
+
+		void toPlanar(HouseGroup& group) const
+		{
+			forEachHole(group, [this](Hole& h) { toPlanar(h); });
+		}
+
+		void toGeographic(HouseGroup& group) const
+		{
+			forEachHole(group, [this](Hole& h) { toGeographic(h); });
+		}
+
+		void toPlanar(MapInfo& map) const
+		{
+			for (auto& pole : map.elec_poles)
+			{
+				toPlanar(pole);
+			}
+			for (auto& group : map.house_groups)
+			{
+				toPlanar(group);
+			}
+		}
+
+		/**
+		 * 批量求球面距离（米），经纬度为弧度。结构数组布局，循环体没有分支，便于编译器向量化
+		 */
+		static void haversine(size_t n, const double* lon1, const double* lat1, const double* lon2, const double* lat2, double* out)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto s_lat = std::sin((lat2[i] - lat1[i]) / 2);
+				auto s_lon = std::sin((lon2[i] - lon1[i]) / 2);
+				auto a = s_lat * s_lat + std::cos(lat1[i]) * std::cos(lat2[i]) * s_lon * s_lon;
+				out[i] = 2 * earth_radius * std::asin(std::sqrt(std::min(1.0, a)));
+			}
+		}
+
+		/**
+		 * 平面坐标折线各段的球面长度（米），第i项为points[i]到points[i + 1]
+		 */
+		std::vector<double> segmentLengths(const std::vector<const Hole*>& points) const
+		{
+			const auto n = points.size();
+			if (n < 2)
+			{
+				return {};
+			}
+			std::vector<double> lon(n), lat(n), length(n - 1);
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto [x, y] = unproject(points[i]->x, points[i]->y);
+				lon[i] = radians(x);
+				lat[i] = radians(y);
+			}
+			haversine(n - 1, lon.data(), lat.data(), lon.data() + 1, lat.data() + 1, length.data());
+			return length;
+		}
+
+		/**
+		 * 平面坐标折线points[0] - points[1] - ...的球面长度（米）
+		 */
+		double pathLength(const std::vector<const Hole*>& points) const
+		{
+			double total = 0;
+			for (auto l : segmentLengths(points))
+			{
+				total += l;
+			}
+			return total;
+		}
+
+		/**
+		 * 两个平面坐标点之间的球面距离（米）
+		 */
+		double length(const Hole& a, const Hole& b) const
+		{
+			return pathLength({ &a, &b });
+		}
+
+		double length(double x1, double y1, double x2, double y2) const
+		{
+			auto [lon1, lat1] = unproject(x1, y1);
+			auto [lon2, lat2] = unproject(x2, y2);
+			double lon[]{ radians(lon1), radians(lon2) }, lat[]{ radians(lat1), radians(lat2) }, length{};
+			haversine(1, lon, lat, lon + 1, lat + 1, &length);
+			return length;
+		}
+
+	private:
+		static constexpr double pi = 3.14159265358979323846;
+
+		static double radians(double degree)
+		{
+			return degree * (pi / 180);
+		}
+
+		static double degrees(double radian)
+		{
+			return radian * (180 / pi);
+		}
+
+		static double round(double degree)
+		{
+			return std::round(degree * 1e9) / 1e9;
+		}
+
+		// 不检查范围的投影，返回(东, 北, 与原点夹角的余弦)。查询矩形只用于取外接矩形，可以超出有效范围
+		std::tuple<double, double, double> tangent(double lon, double lat) const
+		{
+			auto dlon = radians(lon - lon0_);
+			auto sin_lat = std::sin(radians(lat)), cos_lat = std::cos(radians(lat));
+			auto east = earth_radius * cos_lat * std::sin(dlon);
+			auto north = earth_radius * (sin_lat * cos_lat0_ - cos_lat * sin_lat0_ * std::cos(dlon));
+			auto cos_angle = sin_lat * sin_lat0_ + cos_lat * cos_lat0_ * std::cos(dlon);
+			return { east, north, cos_angle };
+		}
+
+		template <typename Fn>
+		static void forEachHole(HouseGroup& group, Fn&& fn)
+		{
+			fn(group.group_front_pole);
+			fn(group.group_back_pole);
+			for (auto& hp : group.house_poles)
+			{
+				fn(hp);
+			}
+		}
+
+		double lon0_;
+		double lat0_;
+		double sin_lat0_;
+		double cos_lat0_;
+		double cos_max_angle_;
+	};
+
+	/**
+	 * 地图为地理坐标时把调用方给出的Hole或HouseGroup转换为平面坐标，平面地图原样返回
+	 */
+	template <typename T>
+	T toPlanar(const GeoFrame* geo, T value)
+	{
+		if (geo)
+		{
+			geo->toPlanar(value);
+		}
+		return value;
+	}
+
+	/**
+	 * 地图为地理坐标时把地图中的Hole或HouseGroup转换为经纬度，平面地图原样返回
+	 */
+	template <typename T>
+	T toGeographic(const GeoFrame* geo, T value)
+	{
+		if (geo)
+		{
+			geo->toGeographic(value);
+		}
+		return value;
+	}
+}
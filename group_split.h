@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include "map_store.h"
+#include "cost_model.h"
+#include "parallel_for.h"
+
+namespace ohtoai {
+	/**
+	 * GroupSplit，房屋组整体接线方案：前front_houses户由组前端点供电，其余由组后端点供电
+	 */
+	struct GroupSplit {
+		/**
+		 * 是否有可用端点，没有时其余字段无意义
+		 */
+		bool feasible{};
+		size_t front_houses{};
+		/**
+		 * 各段线缆长度：电线杆到端点、端点到第一户、沿链到最后一户，没有住户的一段为0
+		 */
+		double front_cable{};
+		double back_cable{};
+		/**
+		 * 按费用模型计算的费用，含供电端点的接线费用
+		 */
+		double cost{};
+
+		double cable() const
+		{
+			return front_cable + back_cable;
+		}
+	};
+
+	/**
+	 * 按度量求链长前缀和，欧氏度量与chainPrefix相同
+	 */
+	template <class Metric>
+	std::vector<double> chainPrefix(const HouseGroup& group, const CostModel<Metric>& model)
+	{
+		std::vector<double> prefix(group.house_poles.size());
+		for (size_t i = 1; i < prefix.size(); ++i)
+		{
+			prefix[i] = prefix[i - 1] + model.length(group.house_poles[i - 1], group.house_poles[i]);
+		}
+		return prefix;
+	}
+
+	/**
+	 * 按度量求端点最近的电线杆：先取欧氏最近的电线杆，其度量距离r内的电线杆都在欧氏距离r内，
+	 * 再在该范围内比较度量距离
+	 */
+	template <class Metric>
+	EndpointAssignment nearestPole(const ElecTable& elec, const Hole& endpoint, const CostModel<Metric>& model)
+	{
+		EndpointAssignment assignment;
+		auto nearest = elec.index.nearest(endpoint.x, endpoint.y, 1);
+		if (nearest.empty())
+		{
+			return assignment;
+		}
+		const auto* best = nearest.front().second;
+		auto best_length = model.length(best->x - endpoint.x, best->y - endpoint.y);
+		if constexpr (!Metric::euclidean)
+		{
+			auto r = best_length;
+			elec.index.query(endpoint.x - r, endpoint.y - r, endpoint.x + r, endpoint.y + r, [&](const PointIndex<std::string>::Entry& e) {
+				auto length = model.length(e.x - endpoint.x, e.y - endpoint.y);
+				if (length < best_length)
+				{
+					best_length = length;
+					best = &e;
+				}
+				return true;
+				});
+		}
+		assignment.elec_id = best->value;
+		assignment.distance = best_length;
+		return assignment;
+	}
+
+	/**
+	 * 按度量求端点最近的k个电线杆，按度量距离升序：欧氏最近的k个电线杆中最大的度量距离r以内的电线杆都在欧氏距离r内
+	 */
+	template <class Metric>
+	std::vector<EndpointAssignment> nearestPoles(const ElecTable& elec, const Hole& endpoint, size_t k, const CostModel<Metric>& model)
+	{
+		std::vector<EndpointAssignment> poles;
+		auto nearest = elec.index.nearest(endpoint.x, endpoint.y, k);
+		if constexpr (Metric::euclidean)
+		{
+			for (const auto& [distance, e] : nearest)
+			{
+				poles.push_back({ e->value, distance });
+			}
+		}
+		else
+		{
+			double r = 0;
+			for (const auto& [distance, e] : nearest)
+			{
+				r = std::max(r, model.length(e->x - endpoint.x, e->y - endpoint.y));
+			}
+			std::vector<std::pair<double, const PointIndex<std::string>::Entry*>> within;
+			elec.index.query(endpoint.x - r, endpoint.y - r, endpoint.x + r, endpoint.y + r, [&](const PointIndex<std::string>::Entry& e) {
+				within.emplace_back(model.length(e.x - endpoint.x, e.y - endpoint.y), &e);
+				return true;
+				});
+			auto count = std::min(k, within.size());
+			std::partial_sort(within.begin(), within.begin() + count, within.end(), [](const auto& a, const auto& b) {
+				return a.first < b.first || (a.first == b.first && a.second->value < b.second->value);
+				});
+			for (size_t i = 0; i < count; ++i)
+			{
+				poles.push_back({ within[i].second->value, within[i].first });
+			}
+		}
+		return poles;
+	}
+
+	/**
+	 * 按度量为房屋组两端分配最近的电线杆，欧氏度量与assignEndpoints相同
+	 */
+	template <class Metric>
+	std::pair<EndpointAssignment, EndpointAssignment> assignEndpoints(const HouseGroup& group, const ElecTable& elec, const CostModel<Metric>& model)
+	{
+		return activateEndpoints(group, nearestPole(elec, group.group_front_pole, model), nearestPole(elec, group.group_back_pole, model));
+	}
+
+	/**
+	 * 求房屋组费用最小的分割点，利用链长前缀和在O(n)内比较所有分割。
+	 * front、back为两端点按同一度量分到的电线杆，端点无效或没有分到电线杆时该端不能供电；两端可以分到同一电线杆。
+	 * 欧氏度量直接使用entry中的前缀和，其他度量重新计算
+	 */
+	template <class Metric = EuclideanMetric>
+	GroupSplit bestSplit(const GroupEntry& entry, const EndpointAssignment& front_pole, const EndpointAssignment& back_pole, const CostModel<Metric>& model = {})
+	{
+		const auto& group = entry.group;
+		const auto& houses = group.house_poles;
+		const auto n = houses.size();
+		auto front_usable = group.group_front_valid && !front_pole.elec_id.empty();
+		auto back_usable = group.group_back_valid && !back_pole.elec_id.empty();
+
+		GroupSplit best;
+		if (n == 0 || (!front_usable && !back_usable))
+		{
+			best.feasible = n == 0;
+			return best;
+		}
+
+		std::vector<double> metric_prefix;
+		if constexpr (!Metric::euclidean)
+		{
+			metric_prefix = chainPrefix(group, model);
+		}
+		const auto& prefix = Metric::euclidean ? entry.prefix : metric_prefix;
+		auto front_lead = front_pole.distance + model.length(group.group_front_pole, houses.front());
+		auto back_lead = back_pole.distance + model.length(group.group_back_pole, houses.back());
+		auto best_cost = std::numeric_limits<double>::infinity();
+		// k为组前端点供电的户数：0..k-1由组前供电，k..n-1由组后供电
+		for (size_t k = 0; k <= n; ++k)
+		{
+			if ((k > 0 && !front_usable) || (k < n && !back_usable))
+			{
+				continue;
+			}
+			auto front = k == 0 ? 0.0 : front_lead + prefix[k - 1];
+			auto back = k == n ? 0.0 : back_lead + prefix[n - 1] - prefix[k];
+			auto cost = model.cost(front + back, k > 0, k < n);
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best = GroupSplit{ true, k, front, back, cost };
+			}
+		}
+		return best;
+	}
+
+	/**
+	 * 地理坐标地图：分割在投影平面上求出，报告的各段线缆长度和费用按球面距离重新计算
+	 */
+	template <class Metric>
+	void geodesicSplit(const MapVersion& map, const GroupEntry& entry, const EndpointAssignment& front_pole, const EndpointAssignment& back_pole,
+		const CostModel<Metric>& model, GroupSplit& split)
+	{
+		const auto& group = entry.group;
+		const auto& houses = group.house_poles;
+		const auto n = houses.size();
+		const auto k = split.front_houses;
+		std::vector<const Hole*> points;
+		if (k > 0)
+		{
+			points = { &map.elec->at(front_pole.elec_id), &group.group_front_pole };
+			for (size_t i = 0; i < k; ++i)
+			{
+				points.push_back(&houses[i]);
+			}
+			split.front_cable = map.geo->pathLength(points);
+		}
+		if (k < n)
+		{
+			points = { &map.elec->at(back_pole.elec_id), &group.group_back_pole };
+			for (auto i = n; i-- > k;)
+			{
+				points.push_back(&houses[i]);
+			}
+			split.back_cable = map.geo->pathLength(points);
+		}
+		split.cost = model.cost(split.cable(), k > 0, k < n);
+	}
+
+	/**
+	 * 按地图中的端点分配求欧氏线缆总长最小的分割点
+	 */
+	inline GroupSplit bestSplit(const GroupEntry& entry)
+	{
+		return bestSplit(entry, entry.front, entry.back);
+	}
+
+	/**
+	 * SplitCost，房屋组最优分割的线缆总长关于两端点到电线杆距离的函数：
+	 * cost(df, db) = min(front_only + df, back_only + db, mixed + df + db)。
+	 * 混合方案断开链上最长的一段，端点无效的方案为无穷大，电线杆移动时无需重新求分割
+	 */
+	struct SplitCost {
+		double front_only{ std::numeric_limits<double>::infinity() };
+		double back_only{ std::numeric_limits<double>::infinity() };
+		double mixed{ std::numeric_limits<double>::infinity() };
+		/**
+		 * 没有住户，不需要线缆
+		 */
+		bool empty{};
+
+		double operator()(double front_distance, double back_distance) const
+		{
+			if (empty)
+			{
+				return 0;
+			}
+			return std::min({ front_only + front_distance, back_only + back_distance, mixed + front_distance + back_distance });
+		}
+	};
+
+	/**
+	 * 由链长前缀和及组前、组后端点到首尾住户的距离求SplitCost，房屋组至少有一户
+	 */
+	inline SplitCost splitCost(const HouseGroup& group, const std::vector<double>& prefix, double front_lead, double back_lead)
+	{
+		const auto& houses = group.house_poles;
+		SplitCost cost;
+		auto chain = prefix.back();
+		if (group.group_front_valid)
+		{
+			cost.front_only = front_lead + chain;
+		}
+		if (group.group_back_valid)
+		{
+			cost.back_only = back_lead + chain;
+		}
+		if (group.group_front_valid && group.group_back_valid && houses.size() > 1)
+		{
+			double longest = 0;
+			for (size_t k = 1; k < houses.size(); ++k)
+			{
+				longest = std::max(longest, prefix[k] - prefix[k - 1]);
+			}
+			cost.mixed = front_lead + back_lead + chain - longest;
+		}
+		return cost;
+	}
+
+	inline SplitCost splitCost(const HouseGroup& group, const std::vector<double>& prefix)
+	{
+		const auto& houses = group.house_poles;
+		if (houses.empty())
+		{
+			SplitCost cost;
+			cost.empty = true;
+			return cost;
+		}
+		return splitCost(group, prefix, ohtoai::distance(group.group_front_pole, houses.front()), ohtoai::distance(group.group_back_pole, houses.back()));
+	}
+
+	/**
+	 * 地理坐标地图按球面距离求SplitCost，调用时两端点到电线杆的距离也取球面距离
+	 */
+	inline SplitCost splitCost(const HouseGroup& group, const GeoFrame& geo)
+	{
+		const auto& houses = group.house_poles;
+		if (houses.empty())
+		{
+			SplitCost cost;
+			cost.empty = true;
+			return cost;
+		}
+		// length[0]为组前端点到第一户，最后一项为最后一户到组后端点，其余为链上各段
+		std::vector<const Hole*> points{ &group.group_front_pole };
+		for (const auto& hp : houses)
+		{
+			points.push_back(&hp);
+		}
+		points.push_back(&group.group_back_pole);
+		auto length = geo.segmentLengths(points);
+		std::vector<double> prefix(houses.size());
+		for (size_t i = 1; i < prefix.size(); ++i)
+		{
+			prefix[i] = prefix[i - 1] + length[i];
+		}
+		return splitCost(group, prefix, length.front(), length.back());
+	}
+
+	/**
+	 * 并行求地图中所有房屋组在费用模型下的最优分割，
+	 * 返回{"version", "cost_model", "cable_length", "cost", "infeasible", "groups"}，
+	 * groups中每项为{"index", "front_houses", "front": {"elec", "cable"}, "back": {"elec", "cable"}}，
+	 * 没有住户的一端为null。没有可用端点的房屋组列在infeasible中。
+	 * 非欧氏度量按该度量重新求各端点最近的电线杆；地理坐标地图的欧氏度量报告球面长度，其他度量为投影平面上的长度
+	 */
+	template <class Metric = EuclideanMetric>
+	nlohmann::json splitAll(const MapVersion& map, const CostModel<Metric>& model = {}, size_t threads = std::thread::hardware_concurrency())
+	{
+		struct Solved {
+			GroupSplit split;
+			EndpointAssignment front;
+			EndpointAssignment back;
+		};
+		std::vector<Solved> solved(map.groups.size());
+		parallelFor(map.groups.size(), [&](size_t i) {
+			const auto& entry = *map.groups[i];
+			auto& s = solved[i];
+			if constexpr (Metric::euclidean)
+			{
+				s.front = entry.front;
+				s.back = entry.back;
+			}
+			else
+			{
+				if (entry.group.group_front_valid)
+				{
+					s.front = nearestPole(*map.elec, entry.group.group_front_pole, model);
+				}
+				if (entry.group.group_back_valid)
+				{
+					s.back = nearestPole(*map.elec, entry.group.group_back_pole, model);
+				}
+			}
+			s.split = bestSplit(entry, s.front, s.back, model);
+			if constexpr (Metric::euclidean)
+			{
+				if (map.geo && s.split.feasible)
+				{
+					geodesicSplit(map, entry, s.front, s.back, model, s.split);
+				}
+			}
+			}, threads, 256);
+
+		nlohmann::json j;
+		j["version"] = map.version;
+		j["cost_model"] = Metric::name;
+		auto& groups = j["groups"] = nlohmann::json::array();
+		auto& infeasible = j["infeasible"] = nlohmann::json::array();
+		double total = 0, cost = 0;
+		for (size_t i = 0; i < solved.size(); ++i)
+		{
+			const auto& [split, front, back] = solved[i];
+			if (!split.feasible)
+			{
+				infeasible.push_back(i);
+				continue;
+			}
+			auto feed = [](const EndpointAssignment& assignment, double cable, bool used) {
+				nlohmann::json f;
+				if (used)
+				{
+					f["elec"] = assignment.elec_id;
+					f["cable"] = cable;
+				}
+				return f;
+			};
+			nlohmann::json g;
+			g["index"] = i;
+			g["front_houses"] = split.front_houses;
+			g["front"] = feed(front, split.front_cable, split.front_houses > 0);
+			g["back"] = feed(back, split.back_cable, split.front_houses < map.groups[i]->group.house_poles.size());
+			groups.push_back(std::move(g));
+			total += split.cable();
+			cost += split.cost;
+		}
+		j["cable_length"] = total;
+		j["cost"] = cost;
+		return j;
+	}
+}
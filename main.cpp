@@ -1,9 +1,170 @@
 #include <cpp-httplib/httplib.h>
 #include <spdlog/spdlog.h>
 #include "elec_hole.h"
+#include "map_store.h"
+#include "map_patch.h"
+#include "map_projection.h"
+#include "map_query.h"
+#include "capacity_assign.h"
+#include "group_split.h"
+#include "pole_planner.h"
+#include "pole_scenario.h"
+#include "voltage_drop.h"
+#include "pareto_search.h"
+#include "wiring_tree.h"
+#include "chain_order.h"
+#include "auto_group.h"
+#include "solution_cache.h"
+#include "single_flight.h"
+#include "precompute.h"
+#include "wire_format.h"
+#include "compression.h"
 
-std::vector<ohtoai::LayoutSolution> getPathSolution(const ohtoai::MapInfo& map, const std::string& id);
-std::map<std::string, ohtoai::MapInfo> MapSet;
+template <class Metric = ohtoai::EuclideanMetric>
+std::vector<ohtoai::LayoutSolution> getPathSolution(const ohtoai::MapVersion& map, const std::string& id, const ohtoai::CostModel<Metric>& model = {});
+template <class Metric = ohtoai::EuclideanMetric>
+std::vector<std::vector<ohtoai::LayoutSolution>> getRankedSolutions(const ohtoai::MapVersion& map, const std::string& id, size_t k, const ohtoai::CostModel<Metric>& model = {});
+nlohmann::json solutionToJson(const std::vector<ohtoai::LayoutSolution>& solution);
+template <class Metric>
+nlohmann::json solutionToJson(const std::vector<ohtoai::LayoutSolution>& solution, const ohtoai::CostModel<Metric>& model);
+nlohmann::json rankedSolutionToJson(const std::vector<std::vector<ohtoai::LayoutSolution>>& solutions);
+template <class Metric>
+nlohmann::json rankedSolutionToJson(const std::vector<std::vector<ohtoai::LayoutSolution>>& solutions, const ohtoai::CostModel<Metric>& model);
+ohtoai::MapStore MapSet;
+// solution响应缓存，默认64MB
+ohtoai::SolutionCache SolutionResponseCache{ 64 << 20 };
+// 地图响应缓存，按(地图版本, 地图名和投影, 编码和压缩方式)缓存，每个版本只序列化和压缩一次
+ohtoai::SolutionCache MapResponseCache{ 128 << 20, 4 };
+// 合并相同地图版本、相同住户、相同编码和压缩方式的并发请求
+ohtoai::SingleFlight<std::tuple<uint64_t, std::string, unsigned>, ohtoai::SolutionCache::Body> MapFlight;
+ohtoai::SingleFlight<std::tuple<uint64_t, std::string, unsigned>, ohtoai::SolutionCache::Body> SolutionFlight;
+
+// 响应缓存中区分编码和压缩方式的key
+unsigned bodyVariant(ohtoai::WireFormat format, ohtoai::ContentEncoding encoding)
+{
+	return static_cast<unsigned>(format) * 4 + static_cast<unsigned>(encoding);
+}
+
+// 住户solution的缓存key：所在房屋组的stamp，房屋组未变化时跨地图版本复用
+uint64_t solutionStamp(const ohtoai::MapVersion& map, const std::string& house)
+{
+	return map.findHouse(house).first->stamp;
+}
+
+// 计算住户solution的响应体并放入缓存，并发的相同请求只计算一次
+ohtoai::SolutionCache::Body computeSolutionBody(std::shared_ptr<const ohtoai::MapVersion> map, const std::string& house,
+	ohtoai::WireFormat format, ohtoai::ContentEncoding encoding = ohtoai::ContentEncoding::identity)
+{
+	auto stamp = solutionStamp(*map, house);
+	auto variant = bodyVariant(format, encoding);
+	return SolutionFlight.run({ stamp, house, variant }, [&map, &house, stamp, format, encoding, variant] {
+		ohtoai::SolutionCache::Body body;
+		if (encoding == ohtoai::ContentEncoding::identity)
+		{
+			auto solution = getPathSolution(*map, house);
+			body = std::make_shared<const std::string>(ohtoai::encode(solutionToJson(solution), format));
+		}
+		else
+		{
+			// 压缩未压缩的响应体，未压缩的版本同样留在缓存中
+			auto plain = SolutionResponseCache.get(stamp, house, bodyVariant(format, ohtoai::ContentEncoding::identity));
+			if (!plain)
+			{
+				plain = computeSolutionBody(map, house, format);
+			}
+			body = std::make_shared<const std::string>(ohtoai::compress(*plain, encoding));
+		}
+		SolutionResponseCache.put(stamp, house, variant, body);
+		return body;
+		});
+}
+
+// 地图响应缓存的key，不同投影分别缓存
+std::string mapBodyKey(const std::string& name, const ohtoai::MapProjection& projection)
+{
+	return name + "/" + projection.key();
+}
+
+// 序列化并压缩地图的一个版本，结果放入缓存，并发的相同请求只计算一次
+ohtoai::SolutionCache::Body computeMapBody(const std::string& name, std::shared_ptr<const ohtoai::MapVersion> map, const ohtoai::MapProjection& projection,
+	ohtoai::WireFormat format, ohtoai::ContentEncoding encoding = ohtoai::ContentEncoding::identity)
+{
+	auto key = mapBodyKey(name, projection);
+	auto variant = bodyVariant(format, encoding);
+	return MapFlight.run({ map->version, key, variant }, [&name, &map, &projection, &key, format, encoding, variant] {
+		ohtoai::SolutionCache::Body body;
+		if (encoding == ohtoai::ContentEncoding::identity)
+		{
+			body = std::make_shared<const std::string>(ohtoai::encode(projection.apply(*map), format));
+		}
+		else
+		{
+			auto plain = MapResponseCache.get(map->version, key, bodyVariant(format, ohtoai::ContentEncoding::identity));
+			if (!plain)
+			{
+				plain = computeMapBody(name, map, projection, format);
+			}
+			body = std::make_shared<const std::string>(ohtoai::compress(*plain, encoding));
+		}
+		MapResponseCache.put(map->version, key, variant, body);
+		return body;
+		});
+}
+
+// 地图提交后在后台预计算所有住户的solution（默认的JSON编码），使用四分之一的CPU核心
+ohtoai::Precomputer Precompute{ std::max(1u, std::thread::hardware_concurrency() / 4),
+	[](std::shared_ptr<const ohtoai::MapVersion> map, const std::string& house) {
+		if (!SolutionResponseCache.contains(solutionStamp(*map, house), house, bodyVariant(ohtoai::WireFormat::json, ohtoai::ContentEncoding::identity)))
+		{
+			computeSolutionBody(std::move(map), house, ohtoai::WireFormat::json);
+		}
+	} };
+
+// 直接从共享的响应缓冲区发送，避免为每个请求复制一份响应体。
+// 响应体已经压缩过，httplib不会再压缩内容提供者的响应，这里自行设置Content-Encoding
+void setSharedContent(httplib::Response& res, ohtoai::SolutionCache::Body body, const std::string& content_type,
+	ohtoai::ContentEncoding encoding = ohtoai::ContentEncoding::identity)
+{
+	res.set_header("Vary", "Accept, Accept-Encoding");
+	if (encoding != ohtoai::ContentEncoding::identity)
+	{
+		res.set_header("Content-Encoding", ohtoai::encodingName(encoding));
+	}
+	if (body->empty())
+	{
+		res.set_content("", content_type);
+		return;
+	}
+	auto length = body->size();
+	res.set_content_provider(length, content_type, [body = std::move(body)](size_t offset, size_t length, httplib::DataSink& sink) {
+		sink.write(body->data() + offset, length);
+		return true;
+		});
+}
+
+// 响应编码：按Accept头协商，pretty=true时输出缩进的JSON
+ohtoai::WireFormat responseFormat(const httplib::Request& req, bool object_root = true)
+{
+	return ohtoai::negotiate(req.get_header_value("Accept"), req.get_param_value("pretty") == "true", object_root);
+}
+
+// 按协商的编码设置响应
+void setEncoded(const httplib::Request& req, httplib::Response& res, const nlohmann::json& j)
+{
+	auto format = responseFormat(req, j.is_object());
+	res.set_content(ohtoai::encode(j, format), ohtoai::contentType(format));
+}
+
+// 设置错误响应
+void setError(httplib::Response& res, int status, const std::exception& e)
+{
+	res.status = status;
+	nlohmann::json ret_body;
+	ret_body["status"] = "error";
+	ret_body["message"] = e.what();
+	res.set_content(ret_body.dump(), "application/json");
+	spdlog::error("{}", e.what());
+}
 
 // 存储MapSet到map.json
 void saveMapSet() {
@@ -14,7 +175,12 @@ void saveMapSet() {
 	}
 	try
 	{
-		ofs << nlohmann::json(MapSet);
+		nlohmann::json j = nlohmann::json::object();
+		for (const auto& [id, map] : MapSet.snapshot())
+		{
+			j[id] = map->toJson();
+		}
+		ofs << j;
 	}
 	catch (const std::exception& e)
 	{
@@ -38,7 +204,47 @@ void loadMapSet() {
 		return;
 	}
 	for (auto& [id, map] : j.items()) {
-		MapSet[id] = map;
+		// 单个地图无效（例如地理坐标超出投影范围）时跳过，不影响其他地图
+		try {
+			auto info = map.get<ohtoai::MapInfo>();
+			auto geo = ohtoai::GeoFrame::fromJson(map, info);
+			MapSet.put(id, std::move(info), std::move(geo));
+		}
+		catch (std::exception& e) {
+			spdlog::error("Cannot load map {} from map.json: {}", id, e.what());
+		}
+	}
+}
+
+std::mutex SaveMutex;
+std::condition_variable SaveCondition;
+bool SavePending{};
+
+// 标记地图已修改，由后台线程写入map.json
+void requestSave()
+{
+	{
+		std::lock_guard lock{ SaveMutex };
+		SavePending = true;
+	}
+	SaveCondition.notify_one();
+}
+
+// 后台写入map.json，短时间内的连续修改只写一次
+void saveLoop()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock lock{ SaveMutex };
+			SaveCondition.wait(lock, [] { return SavePending; });
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		{
+			std::lock_guard lock{ SaveMutex };
+			SavePending = false;
+		}
+		saveMapSet();
 	}
 }
 
@@ -52,6 +258,10 @@ int main(int argc, char** argv)
 	Server svr;
 
 	loadMapSet();
+	std::thread{ saveLoop }.detach();
+
+	// 长轮询的请求在等待期间占用工作线程，ChangeFeed限制同时等待的请求数（32），其余线程留给其他接口
+	svr.new_task_queue = [] { return new ThreadPool(64); };
 
 	svr.set_logger([](const Request& req, const Response& res) {
 		spdlog::info("{} {} {} {} {} {}", req.remote_addr, req.method, req.path, res.status, req.get_header_value("User-Agent"), req.body);
@@ -59,28 +269,31 @@ int main(int argc, char** argv)
 
 	svr.Get("/api/map", [&](const Request& req, Response& res)
 		{
+			auto foreground = Precompute.foreground();
 			try
 	{
-		auto map = MapSet.at(req.get_param_value("map"));
-		res.set_content(nlohmann::json(map).dump(4), "application/json");
+		auto name = req.get_param_value("map");
+		auto map = MapSet.get(name);
+		auto format = responseFormat(req);
+		auto encoding = negotiateEncoding(req.get_header_value("Accept-Encoding"));
+		// include、fields、extra选择返回的成员和字段
+		auto projection = MapProjection::parse(req.get_param_value("include"), req.get_param_value("fields"), req.get_param_value("extra"));
+		// 地图版本不可变，序列化和压缩后的响应体按版本缓存
+		auto body = MapResponseCache.get(map->version, mapBodyKey(name, projection), bodyVariant(format, encoding));
+		if (!body)
+		{
+			body = computeMapBody(name, map, projection, format, encoding);
+		}
+		res.set_header("X-Map-Version", std::to_string(map->version));
+		setSharedContent(res, body, contentType(format), encoding);
 	}
-	catch (const std::out_of_range&e)
+	catch (const std::out_of_range& e)
 	{
-		res.status = 404;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 404, e);
 	}
 	catch (const std::exception& e)
 	{
-		res.status = 406;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 406, e);
 	}
 		});
 
@@ -88,25 +301,613 @@ int main(int argc, char** argv)
 		{
 			try
 	{
-		auto map = nlohmann::json::parse(req.body);
-		MapSet[req.get_param_value("map")] = map.get<MapInfo>();
-		saveMapSet();
+		auto map = decode(req.body, req.get_header_value("Content-Type"));
+		auto name = req.get_param_value("map");
+		// "crs"为"wgs84"时x、y为经纬度，导入时投影到以"origin"为原点的平面
+		auto info = map.get<MapInfo>();
+		auto geo = GeoFrame::fromJson(map, info);
+		auto version = MapSet.put(name, std::move(info), std::move(geo));
+		requestSave();
+		// precompute=true时在后台预计算所有住户，否则取消旧版本未完成的预计算
+		if (req.get_param_value("precompute") == "true")
+		{
+			Precompute.schedule(name, version);
+		}
+		else
+		{
+			Precompute.cancel(name);
+		}
 		res.status = 201;
 		nlohmann::json ret_body;
 		ret_body["status"] = "ok";
-		res.set_content(ret_body.dump(4), "application/json");
+		ret_body["version"] = version->version;
+		setEncoded(req, res, ret_body);
 	}
 	catch (const std::exception& e)
 	{
-		res.status = 406;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 406, e);
 	}
 		});
 
+	// 把{"houses", "elec_poles", "options"}中散列的住户自动分组，返回生成的地图；
+	// 指定map时同时以该名称保存，版本号在X-Map-Version头中。"crs"和"origin"与POST /api/map相同
+	svr.Post("/api/map/autogroup", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				auto body = decode(req.body, req.get_header_value("Content-Type"));
+				MapInfo input;
+				input.elec_poles = body.value("elec_poles", std::vector<Hole>{});
+				input.house_groups.emplace_back().house_poles = body.at("houses").get<std::vector<Hole>>();
+				auto geo = GeoFrame::fromJson(body, input);
+				if (geo)
+				{
+					geo->toPlanar(input);
+				}
+				AutoGrouper grouper{ std::move(input.house_groups.front().house_poles), std::move(input.elec_poles),
+					AutoGroupOptions::fromJson(body.value("options", nlohmann::json())) };
+				auto map = grouper.run();
+				if (geo)
+				{
+					for (auto& pole : map.elec_poles)
+					{
+						geo->toGeographic(pole);
+					}
+					for (auto& group : map.house_groups)
+					{
+						geo->toGeographic(group);
+					}
+				}
+				nlohmann::json ret_body = map;
+				if (geo)
+				{
+					ret_body.update(geo->toJson());
+				}
+				if (req.has_param("map"))
+				{
+					auto name = req.get_param_value("map");
+					auto version = MapSet.put(name, std::move(map), std::move(geo));
+					requestSave();
+					Precompute.cancel(name);
+					res.set_header("X-Map-Version", std::to_string(version->version));
+					res.status = 201;
+				}
+				setEncoded(req, res, ret_body);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 十进制非负整数的请求参数，缺省时为空，含其他字符或超出范围时抛出std::invalid_argument
+	auto unsigned_param = [](const Request& req, const char* key) -> std::optional<uint64_t>
+	{
+		if (!req.has_param(key))
+		{
+			return std::nullopt;
+		}
+		auto value = req.get_param_value(key);
+		if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+		{
+			throw std::invalid_argument(std::string{ "invalid " } + key + ": " + value);
+		}
+		try
+		{
+			return std::stoull(value);
+		}
+		catch (const std::out_of_range&)
+		{
+			throw std::invalid_argument(std::string{ key } + " out of range: " + value);
+		}
+	};
+	auto optional_index = [&](const Request& req, const char* key) -> std::optional<size_t>
+	{
+		return unsigned_param(req, key);
+	};
+	// 请求参数version
+	auto expected_version = [&](const Request& req)
+	{
+		return unsigned_param(req, "version");
+	};
+	// 只读的计算接口：指定的version不是地图的当前版本时抛出StaleVersionError
+	auto check_version = [&](const Request& req, const MapVersion& map)
+	{
+		if (auto expected = expected_version(req); expected && *expected != map.version)
+		{
+			throw StaleVersionError(req.get_param_value("map"), *expected, map.version);
+		}
+	};
+
+	// 是否指定了费用模型参数cost、price、connection
+	auto has_cost_model = [](const Request& req)
+	{
+		return req.has_param("cost") || req.has_param("price") || req.has_param("connection");
+	};
+	// 费用模型只用于/api/solution和/api/map/split，其他计算接口按欧氏线缆长度计算，指定了非默认的费用模型时拒绝，不静默忽略
+	auto euclidean_only = [&](const Request& req)
+	{
+		if (req.has_param("price") || req.has_param("connection") || (req.has_param("cost") && req.get_param_value("cost") != EuclideanMetric::name))
+		{
+			throw std::invalid_argument(req.path + " only supports the euclidean cost model without price or connection");
+		}
+	};
+
+	// 增量修改地图并发布新版本，只重新计算受影响的房屋组。
+	// 指定version时只在该版本上修改，地图已被其他请求修改时返回409
+	auto edit_map = [&](const Request& req, Response& res, const std::function<void(MapEditor&)>& edit)
+	{
+		try
+		{
+			auto name = req.get_param_value("map");
+			auto version = MapSet.update(name, edit, expected_version(req));
+			requestSave();
+			if (req.get_param_value("precompute") == "true")
+			{
+				Precompute.schedule(name, version);
+			}
+			else
+			{
+				Precompute.cancel(name);
+			}
+			nlohmann::json ret_body;
+			ret_body["status"] = "ok";
+			ret_body["version"] = version->version;
+			setEncoded(req, res, ret_body);
+		}
+		catch (const StaleVersionError& e)
+		{
+			setError(res, 409, e);
+		}
+		catch (const PatchTestFailed& e)
+		{
+			setError(res, 409, e);
+		}
+		catch (const std::out_of_range& e)
+		{
+			setError(res, 404, e);
+		}
+		catch (const std::exception& e)
+		{
+			setError(res, 406, e);
+		}
+	};
+
+	// 替换index处的房屋组，index缺省或等于组数时追加
+	svr.Put("/api/map/group", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				auto group = toPlanar(editor.base().geo.get(), decode(req.body, req.get_header_value("Content-Type")).get<HouseGroup>());
+				auto index = optional_index(req, "index").value_or(editor.groupCount());
+				if (index == editor.groupCount())
+				{
+					editor.insertGroup(index, std::move(group));
+				}
+				else
+				{
+					editor.replaceGroup(index, std::move(group));
+				}
+				});
+		});
+
+	svr.Delete("/api/map/group", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				editor.eraseGroup(std::stoul(req.get_param_value("index")));
+				});
+		});
+
+	// 按ID新增或替换住户，新住户需指定group，可用position指定组内位置
+	svr.Put("/api/map/house", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				auto house = toPlanar(editor.base().geo.get(), decode(req.body, req.get_header_value("Content-Type")).get<Hole>());
+				editor.upsertHouse(std::move(house), optional_index(req, "group"), optional_index(req, "position"));
+				});
+		});
+
+	svr.Delete("/api/map/house", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				editor.eraseHouse(req.get_param_value("house"));
+				});
+		});
+
+	// 按ID新增或替换电线杆
+	svr.Put("/api/map/elec", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				editor.upsertElec(toPlanar(editor.base().geo.get(), decode(req.body, req.get_header_value("Content-Type")).get<Hole>()));
+				});
+		});
+
+	svr.Delete("/api/map/elec", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				editor.eraseElec(req.get_param_value("elec"));
+				});
+		});
+
+	// 以RFC 6902 JSON Patch或RFC 7396 Merge Patch修改地图，
+	// Content-Type未指明时数组按JSON Patch、对象按Merge Patch处理；MessagePack、CBOR、BSON的请求体同样按数组或对象区分
+	svr.Patch("/api/map", [&](const Request& req, Response& res)
+		{
+			edit_map(req, res, [&](MapEditor& editor) {
+				auto content_type = req.get_header_value("Content-Type");
+				auto patch = decode(req.body, content_type);
+				auto merge = content_type.find("merge-patch") != std::string::npos
+					|| (content_type.find("json-patch") == std::string::npos && patch.is_object());
+				if (merge)
+				{
+					applyMergePatch(editor, patch);
+				}
+				else
+				{
+					applyJsonPatch(editor, patch);
+				}
+				});
+		});
+
+	// 取since版本之后的修改，没有新修改时最多等待timeout毫秒（默认30秒）
+	svr.Get("/api/map/changes", [&](const Request& req, Response& res)
+		{
+			try
+			{
+				auto since = unsigned_param(req, "since").value_or(0);
+				auto timeout = std::min<uint64_t>(unsigned_param(req, "timeout").value_or(30000), 60000);
+				auto changes = MapSet.feed().since(req.get_param_value("map"), since, std::chrono::milliseconds(timeout));
+				setEncoded(req, res, changes);
+			}
+			catch (const FeedBusyError& e)
+			{
+				res.set_header("Retry-After", "1");
+				setError(res, 503, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 返回与矩形相交的电线杆、房屋组和住户，按offset、limit分页；
+	// 翻页时带上第一页返回的version，地图已被修改时返回409
+	svr.Get("/api/map/bbox", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				auto name = req.get_param_value("map");
+				auto map = MapSet.get(name);
+				check_version(req, *map);
+				RectQuery query;
+				query.min_x = std::stod(req.get_param_value("minx"));
+				query.min_y = std::stod(req.get_param_value("miny"));
+				query.max_x = std::stod(req.get_param_value("maxx"));
+				query.max_y = std::stod(req.get_param_value("maxy"));
+				query.offset = optional_index(req, "offset").value_or(0);
+				query.limit = std::min<size_t>(optional_index(req, "limit").value_or(1000), 10000);
+				query.projection = MapProjection::parse("", req.get_param_value("fields"), req.get_param_value("extra"));
+				setEncoded(req, res, query.run(*map));
+			}
+			catch (const StaleVersionError& e)
+			{
+				setError(res, 409, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 离(x, y)最近的k个住户和k个电线杆
+	svr.Get("/api/map/nearest", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				auto map = MapSet.get(req.get_param_value("map"));
+				NearestQuery query;
+				query.x = std::stod(req.get_param_value("x"));
+				query.y = std::stod(req.get_param_value("y"));
+				query.k = std::min<size_t>(optional_index(req, "k").value_or(1), 1000);
+				query.projection = MapProjection::parse("", req.get_param_value("fields"), req.get_param_value("extra"));
+				setEncoded(req, res, query.run(*map));
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 电线杆的Voronoi单元，minx、miny、maxx、maxy给出裁剪矩形，都不给时取电线杆包围盒
+	svr.Get("/api/map/voronoi", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				auto name = req.get_param_value("map");
+				auto map = MapSet.get(name);
+				check_version(req, *map);
+				VoronoiQuery query;
+				if (req.has_param("minx") || req.has_param("miny") || req.has_param("maxx") || req.has_param("maxy"))
+				{
+					query.box = std::array<double, 4>{ std::stod(req.get_param_value("minx")), std::stod(req.get_param_value("miny")),
+						std::stod(req.get_param_value("maxx")), std::stod(req.get_param_value("maxy")) };
+				}
+				query.projection = MapProjection::parse("", req.get_param_value("fields"), req.get_param_value("extra"));
+				setEncoded(req, res, query.run(*map));
+			}
+			catch (const StaleVersionError& e)
+			{
+				setError(res, 409, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 由电线杆elec供电的房屋组和住户
+	svr.Get("/api/map/served", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				auto map = MapSet.get(req.get_param_value("map"));
+				ServedQuery query;
+				query.elec_id = req.get_param_value("elec");
+				query.projection = MapProjection::parse("", req.get_param_value("fields"), req.get_param_value("extra"));
+				setEncoded(req, res, query.run(*map));
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 在电线杆容量约束下全局分配房屋组端点，请求体为可选的CapacityAssignOptions
+	svr.Post("/api/assign", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto map = MapSet.get(req.get_param_value("map"));
+				auto options = CapacityAssignOptions::fromJson(req.body.empty() ? nlohmann::json() : decode(req.body, req.get_header_value("Content-Type")));
+				setEncoded(req, res, CapacityAssigner{ *map, std::move(options) }.run());
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 规划count个新电线杆的位置，返回各位置及线缆总长的节省
+	svr.Get("/api/map/plan_poles", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto map = MapSet.get(req.get_param_value("map"));
+				auto count = std::min<size_t>(optional_index(req, "count").value_or(1), 10000);
+				setEncoded(req, res, PolePlanner{ *map, count }.run());
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 假设增加、删除或移动电线杆，返回线缆总长的变化和受影响的房屋组，不修改地图。
+	// 请求体为{"edits": [...]}，version与当前版本不一致时返回409
+	svr.Post("/api/map/scenario", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto name = req.get_param_value("map");
+				auto map = MapSet.get(name);
+				check_version(req, *map);
+				auto body = decode(req.body, req.get_header_value("Content-Type"));
+				setEncoded(req, res, PoleScenario{ *map, body.at("edits") }.run());
+			}
+			catch (const StaleVersionError& e)
+			{
+				setError(res, 409, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 每个房屋组在组前、组后之间的最优分割点，使整条链的费用最小。
+	// cost选择度量（euclidean、manhattan），price为每单位长度线缆的价格，connection为每个供电端点的接线费用
+	svr.Get("/api/map/split", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				auto map = MapSet.get(req.get_param_value("map"));
+				setEncoded(req, res, withCostModel(req.get_param_value("cost"), req.get_param_value("price"), req.get_param_value("connection"),
+					[&map](const auto& model) { return splitAll(*map, model); }));
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 沿最优分割的各条线缆链计算电流和电压降，列出末端电压降超过max_drop的链。
+	// 请求体为{"voltage", "resistance", "reactance", "power_factor", "max_drop", "default_load", "loads": {住户ID: 电流}}，均可缺省
+	svr.Post("/api/map/voltage", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto name = req.get_param_value("map");
+				auto map = MapSet.get(name);
+				check_version(req, *map);
+				auto body = req.body.empty() ? nlohmann::json::object() : decode(req.body, req.get_header_value("Content-Type"));
+				setEncoded(req, res, VoltageDrop{ *map, VoltageParams::fromJson(body, *map) }.run());
+			}
+			catch (const StaleVersionError& e)
+			{
+				setError(res, 409, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 区域内房屋组接线方案在线缆总长、电线杆最大负荷、最大电压降三个目标下的Pareto前沿。
+	// 请求体为{"groups": [下标]}或{"box": [minx, miny, maxx, maxy]}，另可给出candidates、max_solutions、max_evaluations、
+	// budget（毫秒）以及与/api/map/voltage相同的负荷和阻抗参数
+	svr.Post("/api/map/pareto", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto name = req.get_param_value("map");
+				auto map = MapSet.get(name);
+				check_version(req, *map);
+				auto body = decode(req.body, req.get_header_value("Content-Type"));
+				setEncoded(req, res, ParetoSearch{ *map, ParetoOptions::fromJson(body, *map) }.run());
+			}
+			catch (const StaleVersionError& e)
+			{
+				setError(res, 409, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 用2-opt/Or-opt重排各房屋组的住户顺序，budget为总时间预算（毫秒）。
+	// 默认只返回结果，apply=true时把变短的房屋组写回地图，地图在计算期间被修改则返回409
+	svr.Post("/api/map/reorder", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto name = req.get_param_value("map");
+				auto map = MapSet.get(name);
+				check_version(req, *map);
+				auto budget = std::chrono::milliseconds(std::min<size_t>(optional_index(req, "budget").value_or(1000), 60000));
+				auto orders = optimizeChains(*map, budget);
+				auto ret_body = chainOrdersToJson(*map, orders);
+				if (req.get_param_value("apply") == "true" && ret_body["improved"].get<size_t>() > 0)
+				{
+					auto next = MapSet.update(name, [&](MapEditor& editor) {
+						for (size_t i = 0; i < orders.size(); ++i)
+						{
+							if (!orders[i].improved())
+							{
+								continue;
+							}
+							auto group = editor.group(i);
+							for (size_t k = 0; k < orders[i].order.size(); ++k)
+							{
+								group.house_poles[k] = editor.group(i).house_poles[orders[i].order[k]];
+							}
+							editor.replaceGroup(i, std::move(group));
+						}
+						}, map->version);
+					requestSave();
+					Precompute.cancel(name);
+					ret_body["applied_version"] = next->version;
+				}
+				setEncoded(req, res, ret_body);
+			}
+			catch (const StaleVersionError& e)
+			{
+				setError(res, 409, e);
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
+	// 把所有住户接到电线杆上的最短线缆网络，steiner=true时插入斯坦纳点，edges=false时只返回汇总
+	svr.Get("/api/map/emst", [&](const Request& req, Response& res)
+		{
+			auto foreground = Precompute.foreground();
+			try
+			{
+				euclidean_only(req);
+				auto map = MapSet.get(req.get_param_value("map"));
+				WiringOptions options;
+				options.steiner = req.get_param_value("steiner") == "true";
+				options.edges = req.get_param_value("edges") != "false";
+				setEncoded(req, res, WiringPlanner{ *map, options }.run());
+			}
+			catch (const std::out_of_range& e)
+			{
+				setError(res, 404, e);
+			}
+			catch (const std::exception& e)
+			{
+				setError(res, 406, e);
+			}
+		});
+
 	svr.Get("/api/map_demo", [&](const Request& req, Response& res)
 		{
 			try
@@ -267,78 +1068,90 @@ int main(int argc, char** argv)
     ]
 }
 )"_json;
-		res.set_content(map.dump(4), "application/json");
+		setEncoded(req, res, map);
 	}
-	catch (const std::out_of_range&e)
+	catch (const std::out_of_range& e)
 	{
-		res.status = 404;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 404, e);
 	}
 	catch (const std::exception& e)
 	{
-		res.status = 406;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 406, e);
 	}
 		});
 
 	svr.Get("/api/solution", [&](const Request& req, Response& res)
 		{
+			auto foreground = Precompute.foreground();
 			try
 	{
-		auto map = MapSet.at(req.get_param_value("map"));
-		auto solution = getPathSolution(map, req.get_param_value("house"));
-		nlohmann::json data;
-		// 遍历输出slns
-		for (auto& sln : solution)
+		auto map = MapSet.get(req.get_param_value("map"));
+		auto house = req.get_param_value("house");
+		// 指定费用模型（与/api/map/split相同的cost、price、connection）时，按该度量分配端点和计算距离，电线杆额外带有distance和cost。
+		// 非欧氏度量的分配依赖所有电线杆，不随stamp缓存
+		if (has_cost_model(req))
 		{
-			nlohmann::json sln_j = sln;
-			std::cout << sln_j.dump(4) << std::endl << std::endl;
-
-			nlohmann::json j;
-			for (auto hp : sln.path)
-			{
-				nlohmann::json p = hp;
-				p["type"] = "house";
-				j.push_back(p);
-			}
-			nlohmann::json edpt = sln.house_endpoint_pole;
-			edpt["type"] = "endpoint";
-			j.push_back(edpt);
-			nlohmann::json elec = sln.elec_pole;
-			elec["type"] = "elec";
-			j.push_back(elec);
-			data.push_back(j);
+			setEncoded(req, res, withCostModel(req.get_param_value("cost"), req.get_param_value("price"), req.get_param_value("connection"),
+				[&](const auto& model) {
+					if (req.has_param("k"))
+					{
+						auto k = std::min<size_t>(std::stoul(req.get_param_value("k")), 100);
+						return rankedSolutionToJson(getRankedSolutions(*map, house, k, model), model);
+					}
+					return solutionToJson(getPathSolution(*map, house, model), model);
+				}));
+			return;
+		}
+		// 指定k时返回每个有效端点最近的k个电线杆。备选结果依赖所有电线杆，不随stamp缓存
+		if (req.has_param("k"))
+		{
+			auto k = std::min<size_t>(std::stoul(req.get_param_value("k")), 100);
+			setEncoded(req, res, rankedSolutionToJson(getRankedSolutions(*map, house, k)));
+			return;
 		}
-		res.set_content(data.dump(4), "application/json");
+		// 同一版本同一住户的结果不变，优先使用缓存
+		// solution的根是数组，不能使用BSON
+		auto format = responseFormat(req, false);
+		auto encoding = negotiateEncoding(req.get_header_value("Accept-Encoding"));
+		auto body = SolutionResponseCache.get(solutionStamp(*map, house), house, bodyVariant(format, encoding));
+		if (!body)
+		{
+			body = computeSolutionBody(map, house, format, encoding);
+		}
+		setSharedContent(res, body, contentType(format), encoding);
 	}
-	catch (const std::out_of_range&e)
+	catch (const std::out_of_range& e)
 	{
-		res.status = 404;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 404, e);
 	}
 	catch (const std::exception& e)
 	{
-		res.status = 406;
-		nlohmann::json ret_body;
-		ret_body["status"] = "error";
-		ret_body["message"] = e.what();
-		res.set_content(ret_body.dump(4), "application/json");
-		spdlog::error("{}", e.what());
+		setError(res, 406, e);
+	}
+		});
+
+	svr.Get("/api/precompute", [&](const Request& req, Response& res)
+		{
+			try
+	{
+		setEncoded(req, res, Precompute.progress(req.get_param_value("map")));
+	}
+	catch (const std::out_of_range& e)
+	{
+		setError(res, 404, e);
 	}
 		});
 
+	svr.Get("/api/stats", [&](const Request& req, Response& res)
+		{
+			nlohmann::json ret_body;
+			ret_body["solution_cache"] = SolutionResponseCache.stats();
+			ret_body["map_cache"] = MapResponseCache.stats();
+			ret_body["single_flight"]["map_coalesced"] = MapFlight.coalesced();
+			ret_body["single_flight"]["solution_coalesced"] = SolutionFlight.coalesced();
+			setEncoded(req, res, ret_body);
+		});
+
 	int port{};
 	// read port from argv
 	if (argc > 1)
@@ -354,112 +1167,211 @@ int main(int argc, char** argv)
 	return 0;
 }
 
-namespace ohtoai
+// 将solution转换为响应格式，每个solution依次为住户、端点和电线杆
+nlohmann::json solutionToJson(const std::vector<ohtoai::LayoutSolution>& solution)
 {
-	double distance(const Hole& h1, const Hole& h2)
+	nlohmann::json data;
+	// 遍历输出slns
+	for (auto& sln : solution)
 	{
-		return std::sqrt(std::pow(h1.x - h2.x, 2) + std::pow(h1.y - h2.y, 2));
+		nlohmann::json j;
+		for (auto hp : sln.path)
+		{
+			nlohmann::json p = hp;
+			p["type"] = "house";
+			j.push_back(p);
+		}
+		nlohmann::json edpt = sln.house_endpoint_pole;
+		edpt["type"] = "endpoint";
+		j.push_back(edpt);
+		nlohmann::json elec = sln.elec_pole;
+		elec["type"] = "elec";
+		j.push_back(elec);
+		data.push_back(j);
 	}
+	return data;
 }
 
-std::vector<ohtoai::LayoutSolution> getPathSolution(const ohtoai::MapInfo& map, const std::string& house_hole_id)
+// 按端点分组的备选solution，电线杆额外带有总距离distance和在该端点中的排名rank（从1开始）
+nlohmann::json rankedSolutionToJson(const std::vector<std::vector<ohtoai::LayoutSolution>>& solutions)
 {
-	std::vector<ohtoai::LayoutSolution> solutions{};
-
-	const auto& [hg, hp] = [&map, &house_hole_id] {
-		// 遍历map的house group
-		for (const auto& hg : map.house_groups)
+	auto data = nlohmann::json::array();
+	for (const auto& ranked : solutions)
+	{
+		auto j = solutionToJson(ranked);
+		for (size_t i = 0; i < ranked.size(); ++i)
 		{
-			// 遍历house group的house pole
-			for (const auto& hp : hg.house_poles)
-			{
-				if (hp.id == house_hole_id)
-				{
-					return std::tuple{ hg , hp };
-				}
-			}
+			auto& elec = j[i].back();
+			elec["distance"] = ranked[i].distance;
+			elec["rank"] = i + 1;
+			data.push_back(std::move(j[i]));
 		}
-		throw "no such house hole id: " + house_hole_id;
-	}();
-	auto& house_group = hg;
-	auto& house_pole = hp;
+	}
+	return data;
+}
 
-	auto front_valid = house_group.group_front_valid;
-	auto back_valid = house_group.group_back_valid;
+// 按费用模型计算的solution，电线杆额外带有按该度量的总距离distance和费用cost（线缆价格加一个端点的接线费用）
+template <class Metric>
+nlohmann::json solutionToJson(const std::vector<ohtoai::LayoutSolution>& solution, const ohtoai::CostModel<Metric>& model)
+{
+	auto data = solutionToJson(solution);
+	for (size_t i = 0; i < solution.size(); ++i)
+	{
+		auto& elec = data[i].back();
+		elec["distance"] = solution[i].distance;
+		elec["cost"] = model.cost(solution[i].distance, true, false);
+	}
+	return data;
+}
 
-	auto house_index = [&house_group, &house_pole] {
-		for (size_t i = 0; i < house_group.house_poles.size(); ++i)
+template <class Metric>
+nlohmann::json rankedSolutionToJson(const std::vector<std::vector<ohtoai::LayoutSolution>>& solutions, const ohtoai::CostModel<Metric>& model)
+{
+	auto data = rankedSolutionToJson(solutions);
+	size_t i = 0;
+	for (const auto& ranked : solutions)
+	{
+		for (const auto& sln : ranked)
 		{
-			if (house_group.house_poles[i].id == house_pole.id)
-			{
-				return i;
-			}
+			data[i++].back()["cost"] = model.cost(sln.distance, true, false);
 		}
-		throw "no such house hole id: " + house_pole.id;
-	}();
-
+	}
+	return data;
+}
 
-	const auto [front_distance, back_distance] = [&house_group, &house_pole, house_index] {
-		// 计算front 到index的距离之和
-		auto front_distance = 0.0;
-		for (size_t i = 0; i < house_index; ++i)
-		{
-			front_distance += ohtoai::distance(house_group.house_poles[i], house_group.house_poles[i + 1]);
-		}
-		// 计算back 到index的距离之和
-		auto back_distance = 0.0;
-		for (size_t i = house_index; i < house_group.house_poles.size() - 1; ++i)
+// 地理坐标地图的solution：坐标反投影为经纬度，geodesic时distance按球面距离重新计算，
+// 与平面地图相同，为电线杆到端点的距离加上front时住户到最后一户、back时第一户到住户的链长。
+// 非欧氏度量与/api/map/split相同，保留投影平面上的长度
+void toGeographic(const ohtoai::MapVersion& map, const ohtoai::GroupEntry& entry, size_t house_index, bool front, ohtoai::LayoutSolution& sln, bool geodesic = true)
+{
+	const auto* geo = map.geo.get();
+	if (!geo)
+	{
+		return;
+	}
+	if (geodesic)
+	{
+		const auto& houses = entry.group.house_poles;
+		std::vector<const ohtoai::Hole*> chain;
+		for (auto i = front ? house_index : 0; i < (front ? houses.size() : house_index + 1); ++i)
 		{
-			back_distance += ohtoai::distance(house_group.house_poles[i], house_group.house_poles[i + 1]);
+			chain.push_back(&houses[i]);
 		}
-		return std::tuple{ front_distance, back_distance };
-	}();
-
-	auto& front_nearest_elec_hole = *std::min_element(map.elec_poles.begin(), map.elec_poles.end(), [&house_group](const auto& e1, const auto& e2) {
-		return ohtoai::distance(e1, house_group.group_front_pole) < ohtoai::distance(e2, house_group.group_front_pole);
-		});
+		sln.distance = geo->length(sln.house_endpoint_pole, sln.elec_pole) + geo->pathLength(chain);
+	}
+	for (auto& hp : sln.path)
+	{
+		geo->toGeographic(hp);
+	}
+	geo->toGeographic(sln.house_endpoint_pole);
+	geo->toGeographic(sln.elec_pole);
+}
 
-	auto& back_nearest_elec_hole = *std::min_element(map.elec_poles.begin(), map.elec_poles.end(), [&house_group](const auto& e1, const auto& e2) {
-		return ohtoai::distance(e1, house_group.group_back_pole) < ohtoai::distance(e2, house_group.group_back_pole);
-		});
+// 每个有效端点最近的k个电线杆对应的solution，先front后back，各自按距离升序。
+// 与getPathSolution不同，两端分到同一电线杆时不去掉任何一端，由调用方比较
+template <class Metric>
+std::vector<std::vector<ohtoai::LayoutSolution>> getRankedSolutions(const ohtoai::MapVersion& map, const std::string& house_hole_id, size_t k, const ohtoai::CostModel<Metric>& model)
+{
+	std::vector<std::vector<ohtoai::LayoutSolution>> solutions{};
 
+	const auto [entry, house_index] = map.findHouse(house_hole_id);
+	const auto& house_group = entry->group;
+	std::vector<double> metric_prefix;
+	if constexpr (!Metric::euclidean)
+	{
+		metric_prefix = ohtoai::chainPrefix(house_group, model);
+	}
+	const auto& prefix = Metric::euclidean ? entry->prefix : metric_prefix;
+	const auto front_distance = prefix[house_index];
+	const auto back_distance = prefix.back() - prefix[house_index];
 
-	if (front_valid && back_valid && front_nearest_elec_hole.id == back_nearest_elec_hole.id)
+	for (auto front : { true, false })
 	{
-		if (ohtoai::distance(front_nearest_elec_hole, house_group.group_front_pole)
-			< ohtoai::distance(back_nearest_elec_hole, house_group.group_back_pole))
+		if (!(front ? house_group.group_front_valid : house_group.group_back_valid))
+		{
+			continue;
+		}
+		const auto& endpoint = front ? house_group.group_front_pole : house_group.group_back_pole;
+		std::vector<ohtoai::Hole> path;
+		if (front)
 		{
-			back_valid = false;
+			for (size_t i = house_index + 1; i-- > 0;)
+			{
+				path.push_back(house_group.house_poles[i]);
+			}
 		}
 		else
 		{
-			front_valid = false;
+			path.assign(house_group.house_poles.begin() + house_index, house_group.house_poles.end());
+		}
+
+		std::vector<ohtoai::LayoutSolution> ranked;
+		for (const auto& pole : ohtoai::nearestPoles(*map.elec, endpoint, k, model))
+		{
+			ohtoai::LayoutSolution sln{};
+			sln.path = path;
+			sln.house_endpoint_pole = endpoint;
+			sln.elec_pole = map.elec->at(pole.elec_id);
+			sln.distance = pole.distance + (front ? back_distance : front_distance);
+			toGeographic(map, *entry, house_index, front, sln, Metric::euclidean);
+			ranked.push_back(std::move(sln));
 		}
+		if (!ranked.empty())
+		{
+			solutions.push_back(std::move(ranked));
+		}
+	}
+	return solutions;
+}
+
+template <class Metric>
+std::vector<ohtoai::LayoutSolution> getPathSolution(const ohtoai::MapVersion& map, const std::string& house_hole_id, const ohtoai::CostModel<Metric>& model)
+{
+	std::vector<ohtoai::LayoutSolution> solutions{};
+
+	const auto [entry, house_index] = map.findHouse(house_hole_id);
+	const auto& house_group = entry->group;
+
+	// 欧氏度量直接使用地图中的端点分配和链长前缀和，其他度量按该度量重新求
+	auto front = entry->front;
+	auto back = entry->back;
+	std::vector<double> metric_prefix;
+	if constexpr (!Metric::euclidean)
+	{
+		std::tie(front, back) = ohtoai::assignEndpoints(house_group, *map.elec, model);
+		metric_prefix = ohtoai::chainPrefix(house_group, model);
 	}
+	const auto& prefix = Metric::euclidean ? entry->prefix : metric_prefix;
+
+	// 由前缀和得到front 到index、index到back的距离之和
+	const auto front_distance = prefix[house_index];
+	const auto back_distance = prefix.back() - prefix[house_index];
 
-	if (front_valid)
+	if (front.active)
 	{
 		ohtoai::LayoutSolution sln{};
-		for (int i = house_index; i >= 0; --i)
+		for (size_t i = house_index + 1; i-- > 0;)
 		{
 			sln.path.push_back(house_group.house_poles[i]);
 		}
 		sln.house_endpoint_pole = house_group.group_front_pole;
-		sln.elec_pole = front_nearest_elec_hole;
-		sln.distance = ohtoai::distance(front_nearest_elec_hole, house_group.group_front_pole) + back_distance;
+		sln.elec_pole = map.elec->at(front.elec_id);
+		sln.distance = front.distance + back_distance;
+		toGeographic(map, *entry, house_index, true, sln, Metric::euclidean);
 		solutions.push_back(sln);
 	}
 
-	if (back_valid)
+	if (back.active)
 	{
 		ohtoai::LayoutSolution sln{};
-		for (int i = house_index; i < house_group.house_poles.size(); ++i)
+		for (size_t i = house_index; i < house_group.house_poles.size(); ++i)
 		{
 			sln.path.push_back(house_group.house_poles[i]);
 		}
 		sln.house_endpoint_pole = house_group.group_back_pole;
-		sln.elec_pole = back_nearest_elec_hole;
-		sln.distance = ohtoai::distance(back_nearest_elec_hole, house_group.group_back_pole) + front_distance;
+		sln.elec_pole = map.elec->at(back.elec_id);
+		sln.distance = back.distance + front_distance;
+		toGeographic(map, *entry, house_index, false, sln, Metric::euclidean);
 		solutions.push_back(sln);
 	}
 
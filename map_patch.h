@@ -0,0 +1,392 @@
+#pragma once
+
+#include <stdexcept>
+#include <unordered_map>
+#include "map_store.h"
+
+namespace ohtoai {
+	/**
+	 * PatchTestFailed，JSON Patch中的test操作不成立
+	 */
+	class PatchTestFailed : public std::runtime_error {
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	/**
+	 * MapPatcher，把JSON Patch操作翻译为MapEditor上的修改
+	 *
+	 * 路径指向某个房屋组或电线杆内部时，只把该元素转换为json修改后再写回，
+	 * 其余元素不做任何复制。
+	 */
+	class MapPatcher {
+	public:
+		explicit MapPatcher(MapEditor& editor) : editor_{ editor } {}
+
+		nlohmann::json get(const std::string& path) const
+		{
+			auto target = resolve(path);
+			if (!target.member)
+			{
+				nlohmann::json j;
+				j["elec_poles"] = memberJson(false);
+				j["house_groups"] = memberJson(true);
+				return j;
+			}
+			if (!target.index)
+			{
+				return memberJson(*target.member);
+			}
+			auto element = elementJson(*target.member, elementIndex(target, false));
+			return target.rest.empty() ? element : element.at(nlohmann::json::json_pointer(target.rest));
+		}
+
+		void add(const std::string& path, const nlohmann::json& value)
+		{
+			auto target = resolve(path);
+			if (!target.member || !target.index)
+			{
+				assign(target, value);
+			}
+			else if (target.rest.empty())
+			{
+				insertElement(*target.member, elementIndex(target, true), value);
+			}
+			else
+			{
+				patchElement(target, "add", &value);
+			}
+		}
+
+		void remove(const std::string& path)
+		{
+			auto target = resolve(path);
+			if (!target.member || !target.index)
+			{
+				throw std::invalid_argument("cannot remove required member: " + path);
+			}
+			if (target.rest.empty())
+			{
+				eraseElement(*target.member, elementIndex(target, false));
+			}
+			else
+			{
+				patchElement(target, "remove", nullptr);
+			}
+		}
+
+		void replace(const std::string& path, const nlohmann::json& value)
+		{
+			auto target = resolve(path);
+			if (!target.member || !target.index)
+			{
+				assign(target, value);
+			}
+			else if (target.rest.empty())
+			{
+				replaceElement(*target.member, elementIndex(target, false), value);
+			}
+			else
+			{
+				patchElement(target, "replace", &value);
+			}
+		}
+
+		// 应用一个RFC 6902操作
+		void apply(const nlohmann::json& operation)
+		{
+			const auto& op = operation.at("op").get_ref<const std::string&>();
+			const auto& path = operation.at("path").get_ref<const std::string&>();
+			if (op == "add")
+			{
+				add(path, operation.at("value"));
+			}
+			else if (op == "remove")
+			{
+				remove(path);
+			}
+			else if (op == "replace")
+			{
+				replace(path, operation.at("value"));
+			}
+			else if (op == "move" || op == "copy")
+			{
+				const auto& from = operation.at("from").get_ref<const std::string&>();
+				if (op == "move" && path.compare(0, from.size() + 1, from + "/") == 0)
+				{
+					throw std::invalid_argument("cannot move " + from + " into its own child " + path);
+				}
+				auto value = get(from);
+				if (op == "move")
+				{
+					remove(from);
+				}
+				add(path, value);
+			}
+			else if (op == "test")
+			{
+				if (get(path) != operation.at("value"))
+				{
+					throw PatchTestFailed("test failed at " + path);
+				}
+			}
+			else
+			{
+				throw std::invalid_argument("unknown patch operation: " + op);
+			}
+		}
+
+		// 整体替换数组成员，与原内容相同的元素保持不变
+		void assignMember(bool groups, const nlohmann::json& values)
+		{
+			if (!values.is_array())
+			{
+				throw std::invalid_argument(std::string(groups ? "house_groups" : "elec_poles") + " must be an array");
+			}
+			auto common = std::min(memberSize(groups), values.size());
+			for (size_t i = 0; i < common; ++i)
+			{
+				replaceElement(groups, i, values[i]);
+			}
+			while (memberSize(groups) > values.size())
+			{
+				eraseElement(groups, memberSize(groups) - 1);
+			}
+			for (auto i = memberSize(groups); i < values.size(); ++i)
+			{
+				insertElement(groups, i, values[i]);
+			}
+		}
+
+	private:
+		/**
+		 * 路径解析结果：member为空表示整个地图，index为空表示整个数组，rest为元素内部的路径
+		 */
+		struct Target {
+			std::optional<bool> member;
+			std::optional<std::string> index;
+			std::string rest;
+			std::string path;
+		};
+
+		static Target resolve(const std::string& path)
+		{
+			Target target;
+			target.path = path;
+			if (path.empty())
+			{
+				return target;
+			}
+			if (path.front() != '/')
+			{
+				throw std::invalid_argument("invalid json pointer: " + path);
+			}
+			auto member_end = path.find('/', 1);
+			auto member = path.substr(1, member_end == std::string::npos ? std::string::npos : member_end - 1);
+			if (member == "house_groups" || member == "elec_poles")
+			{
+				target.member = member == "house_groups";
+			}
+			else
+			{
+				throw std::invalid_argument("unsupported path: " + path);
+			}
+			if (member_end == std::string::npos)
+			{
+				return target;
+			}
+			auto index_end = path.find('/', member_end + 1);
+			target.index = path.substr(member_end + 1, index_end == std::string::npos ? std::string::npos : index_end - member_end - 1);
+			if (index_end != std::string::npos)
+			{
+				target.rest = path.substr(index_end);
+			}
+			return target;
+		}
+
+		size_t elementIndex(const Target& target, bool allow_end) const
+		{
+			const auto& token = *target.index;
+			auto size = memberSize(*target.member);
+			if (allow_end && token == "-")
+			{
+				return size;
+			}
+			if (token.empty() || (token.size() > 1 && token.front() == '0') || token.find_first_not_of("0123456789") != std::string::npos)
+			{
+				throw std::invalid_argument("invalid array index in " + target.path);
+			}
+			auto index = std::stoul(token);
+			if (index > size || (index == size && !allow_end))
+			{
+				throw std::out_of_range("array index out of range in " + target.path);
+			}
+			return index;
+		}
+
+		// 整个地图或整个数组成员的add/replace
+		void assign(const Target& target, const nlohmann::json& value)
+		{
+			if (target.member)
+			{
+				assignMember(*target.member, value);
+				return;
+			}
+			assignMember(false, value.at("elec_poles"));
+			assignMember(true, value.at("house_groups"));
+		}
+
+		// 修改元素内部：只转换该元素
+		void patchElement(const Target& target, const char* op, const nlohmann::json* value)
+		{
+			auto index = elementIndex(target, false);
+			nlohmann::json operation;
+			operation["op"] = op;
+			operation["path"] = target.rest;
+			if (value)
+			{
+				operation["value"] = *value;
+			}
+			auto element = elementJson(*target.member, index).patch(nlohmann::json::array({ operation }));
+			replaceElement(*target.member, index, element);
+		}
+
+		size_t memberSize(bool groups) const
+		{
+			return groups ? editor_.groupCount() : editor_.elecCount();
+		}
+
+		// 地理坐标地图中的元素按经纬度读写
+		nlohmann::json elementJson(bool groups, size_t index) const
+		{
+			const auto* geo = editor_.base().geo.get();
+			return groups ? nlohmann::json(toGeographic(geo, editor_.group(index))) : nlohmann::json(toGeographic(geo, editor_.elecPole(index)));
+		}
+
+		nlohmann::json memberJson(bool groups) const
+		{
+			auto j = nlohmann::json::array();
+			for (size_t i = 0; i < memberSize(groups); ++i)
+			{
+				j.push_back(elementJson(groups, i));
+			}
+			return j;
+		}
+
+		void insertElement(bool groups, size_t index, const nlohmann::json& value)
+		{
+			const auto* geo = editor_.base().geo.get();
+			groups ? editor_.insertGroup(index, ohtoai::toPlanar(geo, value.get<HouseGroup>())) : editor_.insertElec(index, ohtoai::toPlanar(geo, value.get<Hole>()));
+		}
+
+		// 替换元素，转换后与原元素相同时不修改，房屋组的stamp和电线杆的索引保持不变
+		void replaceElement(bool groups, size_t index, const nlohmann::json& value)
+		{
+			const auto* geo = editor_.base().geo.get();
+			if (groups)
+			{
+				const auto& existing = editor_.group(index);
+				auto group = toPlanar(geo, value.get<HouseGroup>(), existing);
+				if (nlohmann::json(group) != nlohmann::json(existing))
+				{
+					editor_.replaceGroup(index, std::move(group));
+				}
+			}
+			else
+			{
+				const auto& existing = editor_.elecPole(index);
+				auto pole = toPlanar(geo, value.get<Hole>(), existing);
+				if (nlohmann::json(pole) != nlohmann::json(existing))
+				{
+					editor_.replaceElec(index, std::move(pole));
+				}
+			}
+		}
+
+		// 地理坐标地图中写回的点：经纬度与原来的点反投影的结果相同时沿用原平面坐标，
+		// 读出的经纬度舍入到1e-9度，原样写回的元素不会因再次投影而漂移
+		static Hole toPlanar(const GeoFrame* geo, Hole value, const Hole& existing)
+		{
+			if (!geo)
+			{
+				return value;
+			}
+			if (std::pair{ value.x, value.y } == geo->unproject(existing.x, existing.y))
+			{
+				value.x = existing.x;
+				value.y = existing.y;
+			}
+			else
+			{
+				geo->toPlanar(value);
+			}
+			return value;
+		}
+
+		// 端点与原来的端点对应，住户按ID与原来的住户对应
+		static HouseGroup toPlanar(const GeoFrame* geo, HouseGroup value, const HouseGroup& existing)
+		{
+			if (!geo)
+			{
+				return value;
+			}
+			value.group_front_pole = toPlanar(geo, std::move(value.group_front_pole), existing.group_front_pole);
+			value.group_back_pole = toPlanar(geo, std::move(value.group_back_pole), existing.group_back_pole);
+			std::unordered_map<std::string, const Hole*> houses;
+			for (const auto& hp : existing.house_poles)
+			{
+				houses.emplace(hp.id, &hp);
+			}
+			for (auto& hp : value.house_poles)
+			{
+				auto it = houses.find(hp.id);
+				hp = it != houses.end() ? toPlanar(geo, std::move(hp), *it->second) : ohtoai::toPlanar(geo, std::move(hp));
+			}
+			return value;
+		}
+
+		void eraseElement(bool groups, size_t index)
+		{
+			groups ? editor_.eraseGroup(index) : editor_.eraseElecAt(index);
+		}
+
+		MapEditor& editor_;
+	};
+
+	// 应用RFC 6902 JSON Patch
+	inline void applyJsonPatch(MapEditor& editor, const nlohmann::json& patch)
+	{
+		if (!patch.is_array())
+		{
+			throw std::invalid_argument("json patch must be an array");
+		}
+		MapPatcher patcher{ editor };
+		for (const auto& operation : patch)
+		{
+			patcher.apply(operation);
+		}
+	}
+
+	// 应用RFC 7396 JSON Merge Patch，数组整体替换，但内容未变的元素保持共享
+	inline void applyMergePatch(MapEditor& editor, const nlohmann::json& patch)
+	{
+		if (!patch.is_object())
+		{
+			throw std::invalid_argument("merge patch must be an object");
+		}
+		MapPatcher patcher{ editor };
+		for (const auto& [key, value] : patch.items())
+		{
+			// 与POST /api/map一致，忽略MapInfo以外的成员
+			if (key != "elec_poles" && key != "house_groups")
+			{
+				continue;
+			}
+			if (value.is_null())
+			{
+				throw std::invalid_argument("cannot remove required member: " + key);
+			}
+			patcher.assignMember(key == "house_groups", value);
+		}
+	}
+}
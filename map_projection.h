@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "map_store.h"
+
+namespace ohtoai {
+	/**
+	 * MapProjection，GET /api/map返回的成员和字段
+	 *
+	 * 直接从MapVersion生成投影后的json，不先生成完整地图再裁剪。
+	 */
+	struct MapProjection {
+		bool elec_poles{ true };
+		bool house_groups{ true };
+		/**
+		 * Hole的字段，对电线杆、组端点和住户同样生效
+		 */
+		bool id{ true };
+		bool x{ true };
+		bool y{ true };
+		bool extra{ true };
+
+		/**
+		 * 由查询参数构造：include为逗号分隔的elec_poles、house_groups，
+		 * fields为逗号分隔的id、x、y、extra，extra为"false"时去掉extra。
+		 * 参数为空表示全部，包含未知名称时抛出std::invalid_argument
+		 */
+		static MapProjection parse(const std::string& include, const std::string& fields, const std::string& extra)
+		{
+			MapProjection projection;
+			if (!include.empty())
+			{
+				projection.elec_poles = projection.house_groups = false;
+				forEachName(include, [&projection](const std::string& name) {
+					if (name == "elec_poles") projection.elec_poles = true;
+					else if (name == "house_groups") projection.house_groups = true;
+					else throw std::invalid_argument("unknown map member: " + name);
+					});
+			}
+			if (!fields.empty())
+			{
+				projection.id = projection.x = projection.y = projection.extra = false;
+				forEachName(fields, [&projection](const std::string& name) {
+					if (name == "id") projection.id = true;
+					else if (name == "x") projection.x = true;
+					else if (name == "y") projection.y = true;
+					else if (name == "extra") projection.extra = true;
+					else throw std::invalid_argument("unknown hole field: " + name);
+					});
+			}
+			if (extra == "false")
+			{
+				projection.extra = false;
+			}
+			return projection;
+		}
+
+		bool full() const
+		{
+			return elec_poles && house_groups && id && x && y && extra;
+		}
+
+		// 用于区分缓存条目的简短描述
+		std::string key() const
+		{
+			std::string key;
+			key += elec_poles ? "e" : "";
+			key += house_groups ? "g" : "";
+			key += id ? "i" : "";
+			key += x ? "x" : "";
+			key += y ? "y" : "";
+			key += extra ? "a" : "";
+			return key;
+		}
+
+		// 地理坐标地图的geo不为空，坐标反投影为经纬度
+		nlohmann::json hole(const Hole& h, const GeoFrame* geo = nullptr) const
+		{
+			auto j = nlohmann::json::object();
+			if (extra) j["extra"] = h.extra;
+			if (id) j["id"] = h.id;
+			if (x || y)
+			{
+				auto [hx, hy] = geo ? geo->unproject(h.x, h.y) : std::pair{ h.x, h.y };
+				if (x) j["x"] = hx;
+				if (y) j["y"] = hy;
+			}
+			return j;
+		}
+
+		nlohmann::json apply(const MapVersion& map) const
+		{
+			if (full())
+			{
+				return map.toJson();
+			}
+			const auto* geo = map.geo.get();
+			auto j = nlohmann::json::object();
+			if (elec_poles)
+			{
+				auto& poles = j["elec_poles"] = nlohmann::json::array();
+				for (const auto& pole : map.elec->poles)
+				{
+					poles.push_back(hole(pole, geo));
+				}
+			}
+			if (house_groups)
+			{
+				auto& groups = j["house_groups"] = nlohmann::json::array();
+				for (const auto& entry : map.groups)
+				{
+					const auto& group = entry->group;
+					nlohmann::json g;
+					g["group_back_pole"] = hole(group.group_back_pole, geo);
+					g["group_back_valid"] = group.group_back_valid;
+					g["group_front_pole"] = hole(group.group_front_pole, geo);
+					g["group_front_valid"] = group.group_front_valid;
+					auto& houses = g["house_poles"] = nlohmann::json::array();
+					for (const auto& hp : group.house_poles)
+					{
+						houses.push_back(hole(hp, geo));
+					}
+					groups.push_back(std::move(g));
+				}
+			}
+			return j;
+		}
+
+	private:
+		template <typename Fn>
+		static void forEachName(const std::string& list, Fn&& fn)
+		{
+			size_t start = 0;
+			while (start <= list.size())
+			{
+				auto end = std::min(list.find(',', start), list.size());
+				auto name = list.substr(start, end - start);
+				start = end + 1;
+				if (!name.empty())
+				{
+					fn(name);
+				}
+			}
+		}
+	};
+}
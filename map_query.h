@@ -0,0 +1,370 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include "map_store.h"
+#include "map_projection.h"
+
+namespace ohtoai {
+	/**
+	 * RectQuery，矩形范围查询，结果可分页
+	 *
+	 * 依次遍历电线杆索引和房屋组点索引，offset和limit按点计数。
+	 * 遍历顺序只由索引结构决定，同一版本上的分页结果稳定。
+	 */
+	struct RectQuery {
+		double min_x{};
+		double min_y{};
+		double max_x{};
+		double max_y{};
+		size_t offset{};
+		size_t limit{ 1000 };
+		MapProjection projection;
+
+		/**
+		 * 返回{"version", "elec_poles", "house_groups", "next"}，
+		 * house_groups中每项为{"index", "group_front_pole", "group_back_pole", "house_poles"}，只含范围内的点，
+		 * 住户带有组内下标"position"。还有更多结果时"next"为下一页的offset。
+		 * 地理坐标地图的矩形为经纬度，在投影后的外接矩形中查找，再按经纬度筛选
+		 */
+		nlohmann::json run(const MapVersion& map) const
+		{
+			const auto* geo = map.geo.get();
+			auto [qx0, qy0, qx1, qy1] = geo ? geo->planarBox(min_x, min_y, max_x, max_y) : std::array<double, 4>{ min_x, min_y, max_x, max_y };
+			auto inside = [&](double x, double y) {
+				return !geo || geo->inside(x, y, min_x, min_y, max_x, max_y);
+			};
+			nlohmann::json j;
+			j["version"] = map.version;
+			auto& elec_poles = j["elec_poles"] = nlohmann::json::array();
+			auto& house_groups = j["house_groups"] = nlohmann::json::array();
+
+			size_t seen = 0;
+			bool more = false;
+			// 跳过offset之前的点，取满limit后再看到一个点即说明还有下一页
+			auto take = [&]() {
+				if (seen++ < offset)
+				{
+					return false;
+				}
+				if (seen > offset + limit)
+				{
+					more = true;
+				}
+				return !more;
+			};
+
+			map.elec->index.query(qx0, qy0, qx1, qy1, [&](const PointIndex<std::string>::Entry& e) {
+				if (inside(e.x, e.y) && take())
+				{
+					elec_poles.push_back(projection.hole(map.elec->at(e.value), map.geo.get()));
+				}
+				return !more;
+				});
+
+			std::unordered_map<const GroupEntry*, size_t> slots;
+			if (!more)
+			{
+				map.group_points.query(qx0, qy0, qx1, qy1, [&](const GroupPointIndex::Entry& e) {
+					if (!inside(e.x, e.y) || !take())
+					{
+						return !more;
+					}
+					const auto& [entry, slot] = e.value;
+					auto [it, inserted] = slots.emplace(entry, house_groups.size());
+					if (inserted)
+					{
+						nlohmann::json g;
+						g["index"] = map.positionOf(entry);
+						g["house_poles"] = nlohmann::json::array();
+						house_groups.push_back(std::move(g));
+					}
+					auto& g = house_groups[it->second];
+					if (slot == GroupPoint::front_slot)
+					{
+						g["group_front_pole"] = projection.hole(entry->group.group_front_pole, map.geo.get());
+					}
+					else if (slot == GroupPoint::back_slot)
+					{
+						g["group_back_pole"] = projection.hole(entry->group.group_back_pole, map.geo.get());
+					}
+					else
+					{
+						auto house = projection.hole(entry->group.house_poles[slot], map.geo.get());
+						house["position"] = slot;
+						g["house_poles"].push_back(std::move(house));
+					}
+					return true;
+					});
+			}
+
+			if (more)
+			{
+				j["next"] = offset + limit;
+			}
+			return j;
+		}
+	};
+
+	/**
+	 * NearestQuery，离给定坐标最近的k个住户和k个电线杆
+	 */
+	struct NearestQuery {
+		double x{};
+		double y{};
+		size_t k{ 1 };
+		MapProjection projection;
+
+		/**
+		 * 返回{"version", "house_poles", "elec_poles"}，均按距离升序，
+		 * 每项带有"distance"，住户另带所在房屋组下标"group"和组内下标"position"。
+		 * 地理坐标地图的(x, y)为经纬度，按投影平面上的距离排序，distance为球面距离
+		 */
+		nlohmann::json run(const MapVersion& map) const
+		{
+			const auto* geo = map.geo.get();
+			Hole at;
+			std::tie(at.x, at.y) = geo ? geo->project(x, y) : std::pair{ x, y };
+			auto length = [&](double distance, const Hole& h) { return geo ? geo->length(at, h) : distance; };
+
+			nlohmann::json j;
+			j["version"] = map.version;
+			auto& elec_poles = j["elec_poles"] = nlohmann::json::array();
+			for (const auto& [distance, e] : map.elec->index.nearest(at.x, at.y, k))
+			{
+				const auto& found = map.elec->at(e->value);
+				auto pole = projection.hole(found, geo);
+				pole["distance"] = length(distance, found);
+				elec_poles.push_back(std::move(pole));
+			}
+
+			auto& house_poles = j["house_poles"] = nlohmann::json::array();
+			auto is_house = [](const GroupPointIndex::Entry& e) { return e.value.slot >= 0; };
+			for (const auto& [distance, e] : map.group_points.nearest(at.x, at.y, k, is_house))
+			{
+				const auto& [entry, slot] = e->value;
+				const auto& found = entry->group.house_poles[slot];
+				auto house = projection.hole(found, geo);
+				house["distance"] = length(distance, found);
+				house["group"] = map.positionOf(entry);
+				house["position"] = slot;
+				house_poles.push_back(std::move(house));
+			}
+			return j;
+		}
+	};
+
+	/**
+	 * ServedQuery，由某个电线杆供电的房屋组、住户和线缆总长
+	 *
+	 * 直接读取版本中的倒排索引，耗时与结果大小成正比。
+	 */
+	struct ServedQuery {
+		std::string elec_id;
+		MapProjection projection;
+
+		/**
+		 * 返回{"version", "elec_pole", "groups", "house_count", "cable_length"}，
+		 * groups中每项为{"index", "endpoint", "distance", "chain_length", "house_poles"}，按房屋组下标排序。
+		 * 线缆长度为端点到电线杆的距离加整条房屋组链长，地理坐标地图为球面距离。电线杆不存在时抛出std::out_of_range
+		 */
+		nlohmann::json run(const MapVersion& map) const
+		{
+			const auto* geo = map.geo.get();
+			const auto& pole = map.elec->at(elec_id);
+			nlohmann::json j;
+			j["version"] = map.version;
+			j["elec_pole"] = projection.hole(pole, geo);
+
+			std::vector<std::pair<size_t, GroupPoint>> points;
+			if (auto served = map.served.find(elec_id))
+			{
+				for (const auto& point : *served)
+				{
+					points.push_back({ map.positionOf(point.entry), point });
+				}
+			}
+			std::sort(points.begin(), points.end(), [](const auto& a, const auto& b) {
+				return a.first < b.first || (a.first == b.first && a.second.slot > b.second.slot);
+				});
+
+			auto& groups = j["groups"] = nlohmann::json::array();
+			size_t house_count = 0;
+			double cable_length = 0;
+			for (const auto& [index, point] : points)
+			{
+				const auto& entry = *point.entry;
+				const auto& assignment = point.slot == GroupPoint::front_slot ? entry.front : entry.back;
+				nlohmann::json g;
+				g["index"] = index;
+				g["endpoint"] = point.slot == GroupPoint::front_slot ? "front" : "back";
+				g["distance"] = geo ? geo->length(point.slot == GroupPoint::front_slot ? entry.group.group_front_pole : entry.group.group_back_pole, pole) : assignment.distance;
+				g["chain_length"] = geo ? geo->pathLength(chain(entry.group)) : entry.prefix.empty() ? 0.0 : entry.prefix.back();
+				auto& houses = g["house_poles"] = nlohmann::json::array();
+				for (const auto& hp : entry.group.house_poles)
+				{
+					houses.push_back(projection.hole(hp, geo));
+				}
+				house_count += entry.group.house_poles.size();
+				cable_length += g["distance"].get<double>() + g["chain_length"].get<double>();
+				groups.push_back(std::move(g));
+			}
+			j["house_count"] = house_count;
+			j["cable_length"] = cable_length;
+			return j;
+		}
+
+	private:
+		static std::vector<const Hole*> chain(const HouseGroup& group)
+		{
+			std::vector<const Hole*> points;
+			for (const auto& hp : group.house_poles)
+			{
+				points.push_back(&hp);
+			}
+			return points;
+		}
+	};
+
+	/**
+	 * VoronoiQuery，电线杆的Voronoi单元（各电线杆的最近供电范围），裁剪到矩形内
+	 *
+	 * Voronoi邻居即Delaunay邻居：从矩形出发，依次用与每个Delaunay邻居的中垂线半平面裁剪，
+	 * 无界单元也由矩形自然封闭。直接使用地图版本中保存的三角剖分，耗时与电线杆数成正比。
+	 */
+	struct VoronoiQuery {
+		/**
+		 * 裁剪矩形，为空时取电线杆包围盒向外扩展10%
+		 */
+		std::optional<std::array<double, 4>> box;
+		MapProjection projection;
+
+		/**
+		 * 返回{"version", "bbox", "cells"}，cells中每项为{"elec_pole", "polygon", "neighbors"}，
+		 * polygon为逆时针（y轴向上）的顶点[x, y]列表，neighbors为相邻单元的电线杆ID。
+		 * 只列出与矩形相交的单元；与其他电线杆坐标重合的电线杆没有单元。
+		 * 地理坐标地图的矩形和顶点为经纬度，单元在投影平面上求出，裁剪矩形为给定矩形投影后的外接矩形
+		 */
+		nlohmann::json run(const MapVersion& map) const
+		{
+			const auto& elec = *map.elec;
+			const auto& delaunay = *elec.delaunay;
+			const auto* geo = map.geo.get();
+			nlohmann::json j;
+			j["version"] = map.version;
+			auto bounds = !box ? defaultBox(elec) : geo ? geo->planarBox((*box)[0], (*box)[1], (*box)[2], (*box)[3]) : *box;
+			j["bbox"] = box ? *box : geo ? geographicBox(*geo, bounds) : bounds;
+			auto& cells = j["cells"] = nlohmann::json::array();
+
+			std::vector<std::vector<size_t>> neighbors(elec.poles.size());
+			delaunay.forEachEdge([&neighbors](size_t a, size_t b) {
+				neighbors[a].push_back(b);
+				neighbors[b].push_back(a);
+				});
+
+			for (size_t i = 0; i < elec.poles.size(); ++i)
+			{
+				// 只有一个电线杆时整个矩形都是它的单元
+				if (neighbors[i].empty() && elec.poles.size() > 1)
+				{
+					continue;
+				}
+				const auto& pole = elec.poles[i];
+				Polygon polygon{ { bounds[0], bounds[1] }, { bounds[2], bounds[1] }, { bounds[2], bounds[3] }, { bounds[0], bounds[3] } };
+				for (auto n : neighbors[i])
+				{
+					polygon = clip(polygon, pole, elec.poles[n]);
+					if (polygon.size() < 3)
+					{
+						break;
+					}
+				}
+				if (polygon.size() < 3)
+				{
+					continue;
+				}
+				nlohmann::json cell;
+				cell["elec_pole"] = projection.hole(pole, map.geo.get());
+				if (geo)
+				{
+					for (auto& vertex : polygon)
+					{
+						auto [lon, lat] = geo->unproject(vertex[0], vertex[1]);
+						vertex = { lon, lat };
+					}
+				}
+				cell["polygon"] = polygon;
+				auto& ids = cell["neighbors"] = nlohmann::json::array();
+				for (auto n : neighbors[i])
+				{
+					ids.push_back(elec.poles[n].id);
+				}
+				cells.push_back(std::move(cell));
+			}
+			return j;
+		}
+
+	private:
+		using Polygon = std::vector<std::array<double, 2>>;
+
+		static std::array<double, 4> defaultBox(const ElecTable& elec)
+		{
+			if (elec.poles.empty())
+			{
+				return { 0, 0, 0, 0 };
+			}
+			auto min_x = elec.poles.front().x, max_x = min_x;
+			auto min_y = elec.poles.front().y, max_y = min_y;
+			for (const auto& pole : elec.poles)
+			{
+				min_x = std::min(min_x, pole.x);
+				max_x = std::max(max_x, pole.x);
+				min_y = std::min(min_y, pole.y);
+				max_y = std::max(max_y, pole.y);
+			}
+			auto margin = std::max({ max_x - min_x, max_y - min_y, 1.0 }) * 0.1;
+			return { min_x - margin, min_y - margin, max_x + margin, max_y + margin };
+		}
+
+		// 平面矩形反投影后的经纬度外接矩形
+		static std::array<double, 4> geographicBox(const GeoFrame& geo, const std::array<double, 4>& bounds)
+		{
+			auto [lon0, lat0] = geo.unproject(bounds[0], bounds[1]);
+			std::array<double, 4> box{ lon0, lat0, lon0, lat0 };
+			for (auto [x, y] : { std::pair{ bounds[2], bounds[1] }, std::pair{ bounds[2], bounds[3] }, std::pair{ bounds[0], bounds[3] } })
+			{
+				auto [lon, lat] = geo.unproject(x, y);
+				box = { std::min(box[0], lon), std::min(box[1], lat), std::max(box[2], lon), std::max(box[3], lat) };
+			}
+			return box;
+		}
+
+		// 保留凸多边形中离site不比离other远的部分（Sutherland-Hodgman，单个半平面）
+		static Polygon clip(const Polygon& polygon, const Hole& site, const Hole& other)
+		{
+			auto nx = other.x - site.x, ny = other.y - site.y;
+			auto mx = (other.x + site.x) / 2, my = (other.y + site.y) / 2;
+			auto side = [&](const std::array<double, 2>& v) { return (v[0] - mx) * nx + (v[1] - my) * ny; };
+
+			Polygon out;
+			for (size_t k = 0; k < polygon.size(); ++k)
+			{
+				const auto& a = polygon[k];
+				const auto& b = polygon[(k + 1) % polygon.size()];
+				auto sa = side(a), sb = side(b);
+				if (sa <= 0)
+				{
+					out.push_back(a);
+				}
+				if ((sa < 0 && sb > 0) || (sa > 0 && sb < 0))
+				{
+					auto t = sa / (sa - sb);
+					out.push_back({ a[0] + (b[0] - a[0]) * t, a[1] + (b[1] - a[1]) * t });
+				}
+			}
+			return out;
+		}
+	};
+}
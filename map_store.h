@@ -0,0 +1,875 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+#include "change_feed.h"
+#include "delaunay.h"
+#include "elec_hole.h"
+#include "geo_frame.h"
+#include "sharded_map.h"
+#include "spatial_index.h"
+
+namespace ohtoai {
+	/**
+	 * EndpointAssignment，组端点分配到的电线杆
+	 */
+	struct EndpointAssignment {
+		/**
+		 * 最近电线杆的ID，地图没有电线杆时为空
+		 */
+		std::string elec_id;
+		double distance{};
+		/**
+		 * 是否由该端点供电：端点有效，且两端分到同一电线杆时只保留较近的一端
+		 */
+		bool active{};
+
+		bool operator==(const EndpointAssignment& other) const
+		{
+			return elec_id == other.elec_id && distance == other.distance && active == other.active;
+		}
+	};
+
+	/**
+	 * GroupEntry，房屋组及其派生数据
+	 */
+	struct GroupEntry {
+		ohtoai::HouseGroup group;
+		/**
+		 * 链长前缀和，prefix[i]为house_poles[0]沿链到house_poles[i]的距离
+		 */
+		std::vector<double> prefix;
+		ohtoai::EndpointAssignment front;
+		ohtoai::EndpointAssignment back;
+		/**
+		 * 房屋组内容或端点分配最近一次变化时的版本号，作为solution缓存的key
+		 */
+		uint64_t stamp{};
+	};
+
+	/**
+	 * ElecTable，电线杆及其索引
+	 */
+	struct ElecTable {
+		std::vector<ohtoai::Hole> poles;
+		std::unordered_map<std::string, size_t> by_id;
+		ohtoai::PointIndex<std::string> index;
+		/**
+		 * 电线杆的Delaunay三角剖分，点的下标与poles一致。电线杆位置或顺序不变的版本之间共享
+		 */
+		std::shared_ptr<const ohtoai::Delaunay> delaunay = std::make_shared<const ohtoai::Delaunay>();
+
+		// 按当前poles重建三角剖分
+		void triangulate()
+		{
+			std::vector<double> coords;
+			coords.reserve(poles.size() * 2);
+			for (const auto& pole : poles)
+			{
+				coords.push_back(pole.x);
+				coords.push_back(pole.y);
+			}
+			delaunay = std::make_shared<const ohtoai::Delaunay>(std::move(coords));
+		}
+
+		// 按ID查找电线杆，不存在时抛出std::out_of_range
+		const Hole& at(const std::string& id) const
+		{
+			auto it = by_id.find(id);
+			if (it == by_id.end())
+			{
+				throw std::out_of_range("no such elec pole id: " + id);
+			}
+			return poles[it->second];
+		}
+	};
+
+	// 计算房屋组的链长前缀和
+	inline std::vector<double> chainPrefix(const HouseGroup& group)
+	{
+		std::vector<double> prefix(group.house_poles.size());
+		for (size_t i = 1; i < group.house_poles.size(); ++i)
+		{
+			prefix[i] = prefix[i - 1] + ohtoai::distance(group.house_poles[i - 1], group.house_poles[i]);
+		}
+		return prefix;
+	}
+
+	// 查找离端点最近的电线杆
+	inline EndpointAssignment nearestElec(const ElecTable& elec, const Hole& endpoint)
+	{
+		EndpointAssignment assignment;
+		auto nearest = elec.index.nearest(endpoint.x, endpoint.y, 1);
+		if (!nearest.empty())
+		{
+			assignment.elec_id = nearest.front().second->value;
+			assignment.distance = nearest.front().first;
+		}
+		return assignment;
+	}
+
+	// 由两端点分到的电线杆确定供电的端点，返回(组前, 组后)
+	inline std::pair<EndpointAssignment, EndpointAssignment> activateEndpoints(const HouseGroup& group, EndpointAssignment front, EndpointAssignment back)
+	{
+		front.active = group.group_front_valid && !front.elec_id.empty();
+		back.active = group.group_back_valid && !back.elec_id.empty();
+
+		// 两端分到同一电线杆时只保留较近的一端
+		if (front.active && back.active && front.elec_id == back.elec_id)
+		{
+			if (front.distance < back.distance)
+			{
+				back.active = false;
+			}
+			else
+			{
+				front.active = false;
+			}
+		}
+		return { front, back };
+	}
+
+	// 为房屋组两端分配最近的电线杆，返回(组前, 组后)
+	inline std::pair<EndpointAssignment, EndpointAssignment> assignEndpoints(const HouseGroup& group, const ElecTable& elec)
+	{
+		return activateEndpoints(group, nearestElec(elec, group.group_front_pole), nearestElec(elec, group.group_back_pole));
+	}
+
+	using HouseIndex = ohtoai::ShardedMap<std::string, std::shared_ptr<const ohtoai::GroupEntry>>;
+
+	/**
+	 * GroupPoint，房屋组中的一个点：slot为住户在组内的下标，或下面的端点常量
+	 */
+	struct GroupPoint {
+		static constexpr int front_slot = -1;
+		static constexpr int back_slot = -2;
+
+		const ohtoai::GroupEntry* entry;
+		int slot;
+
+		bool operator==(const GroupPoint& other) const
+		{
+			return entry == other.entry && slot == other.slot;
+		}
+	};
+
+	using GroupPointIndex = ohtoai::PointIndex<ohtoai::GroupPoint>;
+
+	/**
+	 * 电线杆ID到由其供电的房屋组端点，slot为GroupPoint::front_slot或back_slot
+	 */
+	using ServedIndex = ohtoai::ShardedMap<std::string, std::vector<ohtoai::GroupPoint>>;
+
+	// 在倒排索引中登记或移除房屋组的有效端点
+	inline void addServed(ServedIndex::Writer& served, const GroupEntry& entry)
+	{
+		for (const auto& [assignment, slot] : { std::pair{ &entry.front, GroupPoint::front_slot }, std::pair{ &entry.back, GroupPoint::back_slot } })
+		{
+			if (assignment->active)
+			{
+				served[assignment->elec_id].push_back({ &entry, slot });
+			}
+		}
+	}
+
+	inline void removeServed(ServedIndex::Writer& served, const GroupEntry& entry)
+	{
+		for (const auto& [assignment, slot] : { std::pair{ &entry.front, GroupPoint::front_slot }, std::pair{ &entry.back, GroupPoint::back_slot } })
+		{
+			if (!assignment->active)
+			{
+				continue;
+			}
+			auto points = served.find(assignment->elec_id);
+			if (!points)
+			{
+				continue;
+			}
+			GroupPoint point{ &entry, slot };
+			points->erase(std::remove(points->begin(), points->end(), point), points->end());
+			if (points->empty())
+			{
+				served.erase(assignment->elec_id);
+			}
+		}
+	}
+
+	// 房屋组的所有点：两端端点和各住户
+	inline std::vector<GroupPointIndex::Entry> groupPoints(const GroupEntry& entry)
+	{
+		const auto& group = entry.group;
+		std::vector<GroupPointIndex::Entry> points;
+		points.reserve(group.house_poles.size() + 2);
+		points.push_back({ group.group_front_pole.x, group.group_front_pole.y, { &entry, GroupPoint::front_slot } });
+		points.push_back({ group.group_back_pole.x, group.group_back_pole.y, { &entry, GroupPoint::back_slot } });
+		for (size_t i = 0; i < group.house_poles.size(); ++i)
+		{
+			points.push_back({ group.house_poles[i].x, group.house_poles[i].y, { &entry, static_cast<int>(i) } });
+		}
+		return points;
+	}
+
+	/**
+	 * MapVersion，地图的一个版本
+	 *
+	 * 发布后只读，请求持有shared_ptr即可在不加锁的情况下使用。
+	 * 未修改的房屋组、电线杆表和索引分片在相邻版本之间共享。
+	 */
+	struct MapVersion {
+		/**
+		 * 版本号，全局递增，不同地图之间也不会重复
+		 */
+		uint64_t version{};
+		std::shared_ptr<const ohtoai::ElecTable> elec;
+		std::vector<std::shared_ptr<const ohtoai::GroupEntry>> groups;
+		/**
+		 * 住户ID到所在房屋组
+		 */
+		ohtoai::HouseIndex houses;
+		/**
+		 * 所有房屋组的端点和住户的空间索引，与groups中的房屋组同生命周期
+		 */
+		ohtoai::GroupPointIndex group_points;
+		/**
+		 * 房屋组在groups中的下标
+		 */
+		std::unordered_map<const ohtoai::GroupEntry*, size_t> group_positions;
+		/**
+		 * 电线杆到由其供电的房屋组端点的倒排索引
+		 */
+		ohtoai::ServedIndex served;
+		/**
+		 * 地理坐标地图的局部平面坐标系，平面地图为空。版本中保存的坐标都已投影到该平面
+		 */
+		std::shared_ptr<const ohtoai::GeoFrame> geo;
+		/**
+		 * 按当前端点分配各房屋组最优分割的线缆总长和没有可用端点的房屋组数，版本不可变，首次使用时计算一次
+		 */
+		struct CableTotal {
+			double cable{};
+			size_t unserved{};
+		};
+		mutable std::once_flag cable_total_once;
+		mutable CableTotal cable_total;
+
+		// 房屋组在groups中的下标
+		size_t positionOf(const GroupEntry* entry) const
+		{
+			return group_positions.at(entry);
+		}
+
+		// 查找住户所在的房屋组及组内下标，不存在时抛出std::out_of_range
+		std::pair<std::shared_ptr<const GroupEntry>, size_t> findHouse(const std::string& id) const
+		{
+			auto entry = houses.find(id);
+			if (!entry)
+			{
+				throw std::out_of_range("no such house hole id: " + id);
+			}
+			const auto& house_poles = (*entry)->group.house_poles;
+			auto it = std::find_if(house_poles.begin(), house_poles.end(), [&id](const Hole& hp) { return hp.id == id; });
+			return { *entry, static_cast<size_t>(it - house_poles.begin()) };
+		}
+
+		// 地理坐标地图反投影回经纬度，并带上"crs"和"origin"
+		nlohmann::json toJson() const
+		{
+			auto j = geo ? geo->toJson() : nlohmann::json::object();
+			auto& elec_poles = j["elec_poles"] = nlohmann::json::array();
+			for (const auto& pole : elec->poles)
+			{
+				elec_poles.push_back(geo ? nlohmann::json(toGeographic(geo.get(), pole)) : nlohmann::json(pole));
+			}
+			auto& house_groups = j["house_groups"] = nlohmann::json::array();
+			for (const auto& entry : groups)
+			{
+				house_groups.push_back(geo ? nlohmann::json(toGeographic(geo.get(), entry->group)) : nlohmann::json(entry->group));
+			}
+			return j;
+		}
+
+		// 从完整的MapInfo构建，所有房屋组使用同一个stamp。指定geo时map为经纬度，先投影到平面
+		static std::shared_ptr<MapVersion> build(MapInfo map, uint64_t stamp, std::shared_ptr<const GeoFrame> geo = nullptr)
+		{
+			if (geo)
+			{
+				geo->toPlanar(map);
+			}
+			auto elec = std::make_shared<ElecTable>();
+			elec->poles = std::move(map.elec_poles);
+			std::vector<PointIndex<std::string>::Entry> points;
+			points.reserve(elec->poles.size());
+			for (size_t i = 0; i < elec->poles.size(); ++i)
+			{
+				const auto& pole = elec->poles[i];
+				elec->by_id.emplace(pole.id, i);
+				points.push_back({ pole.x, pole.y, pole.id });
+			}
+			elec->index = PointIndex<std::string>{ std::move(points) };
+			elec->triangulate();
+
+			auto next = std::make_shared<MapVersion>();
+			next->elec = elec;
+			next->geo = std::move(geo);
+			next->groups.reserve(map.house_groups.size());
+			HouseIndex::Writer writer{ next->houses };
+			ServedIndex::Writer served{ next->served };
+			std::vector<GroupPointIndex::Entry> group_points;
+			for (auto& group : map.house_groups)
+			{
+				auto entry = std::make_shared<GroupEntry>();
+				entry->group = std::move(group);
+				entry->prefix = chainPrefix(entry->group);
+				entry->stamp = stamp;
+				std::tie(entry->front, entry->back) = assignEndpoints(entry->group, *elec);
+				// 住户ID重复时以第一次出现的为准
+				for (const auto& hp : entry->group.house_poles)
+				{
+					writer.emplace(hp.id, entry);
+				}
+				addServed(served, *entry);
+				auto entry_points = groupPoints(*entry);
+				group_points.insert(group_points.end(), entry_points.begin(), entry_points.end());
+				next->group_positions.emplace(entry.get(), next->groups.size());
+				next->groups.push_back(std::move(entry));
+			}
+			next->group_points = GroupPointIndex{ std::move(group_points) };
+			return next;
+		}
+	};
+
+	/**
+	 * MapEditor，在某一版本上做增量修改并生成新版本
+	 *
+	 * 只重新计算被修改房屋组的前缀和，只更新受影响的住户索引分片、
+	 * 电线杆索引路径和端点分配；其余房屋组原样共享，stamp不变，缓存的solution继续有效。
+	 */
+	class MapEditor {
+	public:
+		explicit MapEditor(std::shared_ptr<const MapVersion> base)
+			: base_{ std::move(base) }, groups_{ base_->groups }, elec_{ base_->elec }
+		{
+		}
+
+		const MapVersion& base() const
+		{
+			return *base_;
+		}
+
+		size_t groupCount() const
+		{
+			return groups_.size();
+		}
+
+		const HouseGroup& group(size_t index) const
+		{
+			return groups_.at(index)->group;
+		}
+
+		const ElecTable& elec() const
+		{
+			return *elec_;
+		}
+
+		// 在index处插入房屋组，index等于组数时追加
+		void insertGroup(size_t index, HouseGroup group)
+		{
+			if (index > groups_.size())
+			{
+				throw std::out_of_range("no such house group index: " + std::to_string(index));
+			}
+			record("add", "/house_groups/" + std::to_string(index), group);
+			groups_.insert(groups_.begin() + index, makeFresh(std::move(group)));
+		}
+
+		void replaceGroup(size_t index, HouseGroup group)
+		{
+			drop(groups_.at(index));
+			record("replace", "/house_groups/" + std::to_string(index), group);
+			groups_[index] = makeFresh(std::move(group));
+		}
+
+		void eraseGroup(size_t index)
+		{
+			drop(groups_.at(index));
+			record("remove", "/house_groups/" + std::to_string(index));
+			groups_.erase(groups_.begin() + index);
+		}
+
+		// 新增或替换住户；group为空时住户必须已存在，position为空时保持原位置或追加到末尾
+		void upsertHouse(Hole house, std::optional<size_t> group, std::optional<size_t> position)
+		{
+			auto found = locateHouse(house.id);
+			if (!found && !group)
+			{
+				throw std::out_of_range("no such house hole id: " + house.id);
+			}
+			if (found && (!group || *group == found->first) && !position)
+			{
+				auto updated = groups_[found->first]->group;
+				updated.house_poles[found->second] = std::move(house);
+				replaceGroup(found->first, std::move(updated));
+				return;
+			}
+			if (found)
+			{
+				eraseHouseAt(found->first, found->second);
+			}
+			auto target = group ? *group : found->first;
+			auto updated = groups_.at(target)->group;
+			auto at = position ? *position : updated.house_poles.size();
+			if (at > updated.house_poles.size())
+			{
+				throw std::out_of_range("no such house position: " + std::to_string(at));
+			}
+			updated.house_poles.insert(updated.house_poles.begin() + at, std::move(house));
+			replaceGroup(target, std::move(updated));
+		}
+
+		void eraseHouse(const std::string& id)
+		{
+			auto found = locateHouse(id);
+			if (!found)
+			{
+				throw std::out_of_range("no such house hole id: " + id);
+			}
+			eraseHouseAt(found->first, found->second);
+		}
+
+		size_t elecCount() const
+		{
+			return elec_->poles.size();
+		}
+
+		const Hole& elecPole(size_t index) const
+		{
+			return elec_->poles.at(index);
+		}
+
+		// 在index处插入电线杆，index等于电线杆数时追加
+		void insertElec(size_t index, Hole pole)
+		{
+			if (index > elec_->poles.size())
+			{
+				throw std::out_of_range("no such elec pole index: " + std::to_string(index));
+			}
+			if (elec_->by_id.count(pole.id))
+			{
+				throw std::invalid_argument("duplicate elec pole id: " + pole.id);
+			}
+			auto& elec = mutableElec();
+			for (auto& [id, i] : elec.by_id)
+			{
+				if (i >= index)
+				{
+					++i;
+				}
+			}
+			elec.by_id.emplace(pole.id, index);
+			elec.index.insert({ pole.x, pole.y, pole.id });
+			added_poles_.insert(pole.id);
+			poles_moved_ = true;
+			record("add", "/elec_poles/" + std::to_string(index), pole);
+			elec.poles.insert(elec.poles.begin() + index, std::move(pole));
+		}
+
+		void replaceElec(size_t index, Hole pole)
+		{
+			const auto& old = elecPole(index);
+			if (old.id != pole.id && elec_->by_id.count(pole.id))
+			{
+				throw std::invalid_argument("duplicate elec pole id: " + pole.id);
+			}
+			auto& elec = mutableElec();
+			auto& current = elec.poles[index];
+			elec.index.erase(current.x, current.y, current.id);
+			changed_poles_.insert(current.id);
+			if (current.id != pole.id)
+			{
+				if (auto it = elec.by_id.find(current.id); it != elec.by_id.end() && it->second == index)
+				{
+					elec.by_id.erase(it);
+				}
+				elec.by_id.emplace(pole.id, index);
+			}
+			elec.index.insert({ pole.x, pole.y, pole.id });
+			added_poles_.insert(pole.id);
+			poles_moved_ = poles_moved_ || current.x != pole.x || current.y != pole.y;
+			record("replace", "/elec_poles/" + std::to_string(index), pole);
+			current = std::move(pole);
+		}
+
+		void eraseElecAt(size_t index)
+		{
+			elecPole(index);
+			auto& elec = mutableElec();
+			const auto& pole = elec.poles[index];
+			elec.index.erase(pole.x, pole.y, pole.id);
+			changed_poles_.insert(pole.id);
+			added_poles_.erase(pole.id);
+			if (auto it = elec.by_id.find(pole.id); it != elec.by_id.end() && it->second == index)
+			{
+				elec.by_id.erase(it);
+			}
+			for (auto& [id, i] : elec.by_id)
+			{
+				if (i > index)
+				{
+					--i;
+				}
+			}
+			elec.poles.erase(elec.poles.begin() + index);
+			poles_moved_ = true;
+			record("remove", "/elec_poles/" + std::to_string(index));
+		}
+
+		// 按ID新增或替换电线杆，新电线杆追加到末尾
+		void upsertElec(Hole pole)
+		{
+			if (auto it = elec_->by_id.find(pole.id); it != elec_->by_id.end())
+			{
+				replaceElec(it->second, std::move(pole));
+			}
+			else
+			{
+				insertElec(elec_->poles.size(), std::move(pole));
+			}
+		}
+
+		void eraseElec(const std::string& id)
+		{
+			auto it = elec_->by_id.find(id);
+			if (it == elec_->by_id.end())
+			{
+				throw std::out_of_range("no such elec pole id: " + id);
+			}
+			eraseElecAt(it->second);
+		}
+
+		// 本次修改对应的JSON Patch，按修改顺序记录
+		const nlohmann::json& changes() const
+		{
+			return changes_;
+		}
+
+		// 生成新版本，新建和端点分配变化的房屋组使用stamp，版本号由MapStore发布时分配
+		std::shared_ptr<MapVersion> commit(uint64_t stamp)
+		{
+			if (poles_moved_)
+			{
+				owned_elec_->triangulate();
+				poles_moved_ = false;
+			}
+			auto next = std::make_shared<MapVersion>();
+			next->elec = elec_;
+			next->geo = base_->geo;
+			next->houses = base_->houses;
+			next->group_points = base_->group_points;
+			next->served = base_->served;
+			HouseIndex::Writer houses{ next->houses };
+			ServedIndex::Writer served{ next->served };
+			auto& points = next->group_points;
+			auto erase_points = [&points](const GroupEntry& entry) {
+				for (const auto& point : groupPoints(entry))
+				{
+					points.erase(point.x, point.y, point.value);
+				}
+			};
+			auto insert_points = [&points](const GroupEntry& entry) {
+				for (auto& point : groupPoints(entry))
+				{
+					points.insert(std::move(point));
+				}
+			};
+
+			for (const auto& entry : removed_)
+			{
+				erase_points(*entry);
+				removeServed(served, *entry);
+				for (const auto& hp : entry->group.house_poles)
+				{
+					if (auto owner = houses.find(hp.id); owner && *owner == entry)
+					{
+						houses.erase(hp.id);
+					}
+				}
+			}
+
+			next->groups.reserve(groups_.size());
+			for (const auto& slot : groups_)
+			{
+				if (auto it = fresh_.find(slot.get()); it != fresh_.end())
+				{
+					auto& updated = it->second;
+					std::tie(updated->front, updated->back) = assignEndpoints(updated->group, *elec_);
+					updated->stamp = stamp;
+					for (const auto& hp : updated->group.house_poles)
+					{
+						houses[hp.id] = updated;
+					}
+					insert_points(*updated);
+					addServed(served, *updated);
+					next->groups.push_back(std::move(updated));
+					continue;
+				}
+
+				if (!owned_elec_ || !mayReassign(*slot))
+				{
+					next->groups.push_back(slot);
+					continue;
+				}
+				// 分配结果和所用电线杆都没有变化时保留原房屋组
+				auto [front, back] = assignEndpoints(slot->group, *elec_);
+				if (front == slot->front && back == slot->back && !changed_poles_.count(front.elec_id) && !changed_poles_.count(back.elec_id))
+				{
+					next->groups.push_back(slot);
+					continue;
+				}
+				auto updated = std::make_shared<GroupEntry>(*slot);
+				updated->front = front;
+				updated->back = back;
+				updated->stamp = stamp;
+				for (const auto& hp : updated->group.house_poles)
+				{
+					if (auto owner = houses.find(hp.id); owner && *owner == slot)
+					{
+						*owner = updated;
+					}
+				}
+				erase_points(*slot);
+				insert_points(*updated);
+				removeServed(served, *slot);
+				addServed(served, *updated);
+				next->groups.push_back(std::move(updated));
+			}
+			for (size_t i = 0; i < next->groups.size(); ++i)
+			{
+				next->group_positions.emplace(next->groups[i].get(), i);
+			}
+			return next;
+		}
+
+	private:
+		void record(const char* op, std::string path, const nlohmann::json& value = nullptr)
+		{
+			nlohmann::json change;
+			change["op"] = op;
+			change["path"] = std::move(path);
+			if (!value.is_null())
+			{
+				change["value"] = value;
+			}
+			changes_.push_back(std::move(change));
+		}
+
+		// 记录房屋组或电线杆，地理坐标地图记录为经纬度，与GET /api/map一致
+		template <typename T>
+		void record(const char* op, std::string path, const T& value)
+		{
+			const auto* geo = base_->geo.get();
+			record(op, std::move(path), geo ? nlohmann::json(toGeographic(geo, value)) : nlohmann::json(value));
+		}
+
+		std::shared_ptr<const GroupEntry> makeFresh(HouseGroup group)
+		{
+			auto entry = std::make_shared<GroupEntry>();
+			entry->group = std::move(group);
+			entry->prefix = chainPrefix(entry->group);
+			fresh_.emplace(entry.get(), entry);
+			return entry;
+		}
+
+		// 房屋组从地图中移除：本次新建的直接丢弃，原有的记录下来以便清理索引
+		void drop(const std::shared_ptr<const GroupEntry>& entry)
+		{
+			if (fresh_.erase(entry.get()) == 0)
+			{
+				removed_.push_back(entry);
+			}
+		}
+
+		void eraseHouseAt(size_t group, size_t position)
+		{
+			auto updated = groups_[group]->group;
+			updated.house_poles.erase(updated.house_poles.begin() + position);
+			replaceGroup(group, std::move(updated));
+		}
+
+		// 在当前编辑状态中查找住户，返回(组下标, 组内下标)
+		std::optional<std::pair<size_t, size_t>> locateHouse(const std::string& id) const
+		{
+			auto find_in = [&id](const GroupEntry& entry) -> std::optional<size_t> {
+				const auto& house_poles = entry.group.house_poles;
+				auto it = std::find_if(house_poles.begin(), house_poles.end(), [&id](const Hole& hp) { return hp.id == id; });
+				if (it == house_poles.end())
+				{
+					return std::nullopt;
+				}
+				return static_cast<size_t>(it - house_poles.begin());
+			};
+
+			// 原版本中的房屋组若仍在当前状态中则直接使用，否则在本次新建的房屋组中查找
+			const GroupEntry* candidate{};
+			if (auto entry = base_->houses.find(id))
+			{
+				candidate = entry->get();
+			}
+			for (size_t i = 0; i < groups_.size(); ++i)
+			{
+				const auto* entry = groups_[i].get();
+				if (entry == candidate || fresh_.count(entry))
+				{
+					if (auto position = find_in(*entry))
+					{
+						return std::pair{ i, *position };
+					}
+				}
+			}
+			return std::nullopt;
+		}
+
+		ElecTable& mutableElec()
+		{
+			if (!owned_elec_)
+			{
+				owned_elec_ = std::make_shared<ElecTable>(*elec_);
+				elec_ = owned_elec_;
+			}
+			return *owned_elec_;
+		}
+
+		// 电线杆变化后端点分配是否可能改变：原分配的电线杆被修改或删除，或新电线杆不比原分配远。
+		// 新增的电线杆较多时逐个比较不如直接查索引，一律返回true
+		bool mayReassign(const GroupEntry& entry) const
+		{
+			if (added_poles_.size() > 16)
+			{
+				return true;
+			}
+			for (const auto& [endpoint, assignment] : { std::pair{ &entry.group.group_front_pole, &entry.front }, std::pair{ &entry.group.group_back_pole, &entry.back } })
+			{
+				if (assignment->elec_id.empty() ? !added_poles_.empty() : changed_poles_.count(assignment->elec_id) > 0)
+				{
+					return true;
+				}
+				for (const auto& id : added_poles_)
+				{
+					if (ohtoai::distance(*endpoint, elec_->at(id)) <= assignment->distance)
+					{
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		std::shared_ptr<const MapVersion> base_;
+		std::vector<std::shared_ptr<const GroupEntry>> groups_;
+		std::shared_ptr<const ElecTable> elec_;
+		std::shared_ptr<ElecTable> owned_elec_;
+		std::unordered_map<const GroupEntry*, std::shared_ptr<GroupEntry>> fresh_;
+		std::vector<std::shared_ptr<const GroupEntry>> removed_;
+		std::unordered_set<std::string> changed_poles_;
+		std::unordered_set<std::string> added_poles_;
+		bool poles_moved_{};
+		nlohmann::json changes_ = nlohmann::json::array();
+	};
+
+	/**
+	 * StaleVersionError，修改所基于的版本已不是地图的当前版本
+	 */
+	class StaleVersionError : public std::runtime_error {
+	public:
+		StaleVersionError(const std::string& name, uint64_t expected, uint64_t current)
+			: std::runtime_error("map " + name + " is at version " + std::to_string(current) + ", not " + std::to_string(expected)),
+			current_{ current }
+		{
+		}
+
+		uint64_t current() const
+		{
+			return current_;
+		}
+
+	private:
+		uint64_t current_;
+	};
+
+	/**
+	 * MapStore，按名称保存各地图的当前版本
+	 */
+	class MapStore {
+	public:
+		// 获取地图当前版本，不存在时抛出std::out_of_range
+		std::shared_ptr<const MapVersion> get(const std::string& name) const
+		{
+			std::lock_guard lock{ mutex_ };
+			return maps_.at(name);
+		}
+
+		// 替换地图，返回新版本。geo不为空时map为经纬度
+		std::shared_ptr<const MapVersion> put(const std::string& name, MapInfo map, std::shared_ptr<const GeoFrame> geo = nullptr)
+		{
+			auto entry = MapVersion::build(std::move(map), next_version_++, std::move(geo));
+
+			// 在锁内分配版本号，保证同一地图的版本单调递增
+			std::lock_guard lock{ mutex_ };
+			entry->version = next_version_++;
+			maps_[name] = entry;
+			feed_.reset(name, entry->version);
+			return entry;
+		}
+
+		// 在地图当前版本上修改并发布，期间地图被其他请求修改时基于新版本重新执行edit。
+		// 指定expected时只允许基于该版本修改，否则抛出StaleVersionError
+		template <typename Fn>
+		std::shared_ptr<const MapVersion> update(const std::string& name, Fn&& edit, std::optional<uint64_t> expected = std::nullopt)
+		{
+			for (;;)
+			{
+				auto base = get(name);
+				if (expected && base->version != *expected)
+				{
+					throw StaleVersionError(name, *expected, base->version);
+				}
+				MapEditor editor{ base };
+				edit(editor);
+				auto next = editor.commit(next_version_++);
+
+				std::lock_guard lock{ mutex_ };
+				auto& current = maps_.at(name);
+				if (current == base)
+				{
+					next->version = next_version_++;
+					current = next;
+					feed_.append(name, base->version, next->version, editor.changes());
+					return next;
+				}
+			}
+		}
+
+		// 地图的修改记录，在发布版本的锁内写入，顺序与版本一致
+		const ChangeFeed& feed() const
+		{
+			return feed_;
+		}
+
+		// 所有地图当前版本的快照
+		std::map<std::string, std::shared_ptr<const MapVersion>> snapshot() const
+		{
+			std::lock_guard lock{ mutex_ };
+			return maps_;
+		}
+
+	private:
+		mutable std::mutex mutex_;
+		std::map<std::string, std::shared_ptr<const MapVersion>> maps_;
+		std::atomic<uint64_t> next_version_{ 1 };
+		ChangeFeed feed_;
+	};
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ohtoai {
+	/**
+	 * 并行执行fn(0)到fn(count - 1)，按块分给threads个线程（含调用线程）动态领取。
+	 * 任一调用抛出异常时其余线程尽快停止，第一个异常在调用线程中重新抛出
+	 */
+	template <typename Fn>
+	void parallelFor(size_t count, Fn&& fn, size_t threads = std::thread::hardware_concurrency(), size_t chunk = 64)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		chunk = std::max<size_t>(chunk, 1);
+		threads = std::clamp<size_t>(threads, 1, (count + chunk - 1) / chunk);
+		std::atomic<size_t> next{};
+		std::atomic<bool> failed{};
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		auto worker = [&]() {
+			try
+			{
+				for (;;)
+				{
+					auto begin = next.fetch_add(chunk);
+					if (begin >= count || failed)
+					{
+						return;
+					}
+					for (auto i = begin, end = std::min(begin + chunk, count); i < end; ++i)
+					{
+						fn(i);
+					}
+				}
+			}
+			catch (...)
+			{
+				std::lock_guard lock{ error_mutex };
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+				failed = true;
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t i = 1; i < threads; ++i)
+		{
+			pool.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : pool)
+		{
+			thread.join();
+		}
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,869 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "voltage_drop.h"
+
+namespace ohtoai {
+	/**
+	 * ParetoOptions，多目标搜索的参数
+	 */
+	struct ParetoOptions {
+		/**
+		 * 参与搜索的房屋组下标，按升序排列
+		 */
+		std::vector<size_t> groups;
+		/**
+		 * 每个有效端点考虑的最近电线杆数，由空间索引的k近邻查询得到，最多max_candidates。
+		 * 每个房屋组的方案数为candidates²·(户数+1)，去掉被支配的分割点是平方复杂度
+		 */
+		size_t candidates{ 4 };
+		size_t max_candidates{ 32 };
+		/**
+		 * 返回的Pareto解的个数上限，超出时按拥挤距离保留分布均匀的解
+		 */
+		size_t max_solutions{ 16 };
+		/**
+		 * 评价的方案数上限，全部组合数不超过它时穷举，得到精确的Pareto前沿
+		 */
+		size_t max_evaluations{ 1 << 20 };
+		size_t max_groups{ 256 };
+		std::chrono::milliseconds budget{ 200 };
+		/**
+		 * 住户负荷和线缆阻抗，与电压降计算相同
+		 */
+		VoltageParams electrical;
+
+		/**
+		 * 区域由"groups"（房屋组下标数组）或"box"（[minx, miny, maxx, maxy]，有点落在其中的房屋组）给出，
+		 * 地理坐标地图的box为经纬度。其余字段缺省时取默认值，candidates超过max_candidates时取max_candidates，budget为毫秒，最多60000
+		 */
+		static ParetoOptions fromJson(const nlohmann::json& j, const MapVersion& map)
+		{
+			ParetoOptions options;
+			options.candidates = std::min(j.value("candidates", options.candidates), options.max_candidates);
+			options.max_solutions = j.value("max_solutions", options.max_solutions);
+			options.max_evaluations = j.value("max_evaluations", options.max_evaluations);
+			options.budget = std::chrono::milliseconds(std::min<size_t>(j.value("budget", static_cast<size_t>(options.budget.count())), 60000));
+			options.electrical = VoltageParams::fromJson(j, map);
+			if (options.candidates == 0 || options.max_solutions == 0)
+			{
+				throw std::invalid_argument("candidates and max_solutions must be positive");
+			}
+
+			if (j.contains("groups"))
+			{
+				for (const auto& index : j.at("groups"))
+				{
+					auto i = index.get<size_t>();
+					map.groups.at(i);
+					options.groups.push_back(i);
+				}
+			}
+			else if (j.contains("box"))
+			{
+				auto box = j.at("box").get<std::array<double, 4>>();
+				const auto* geo = map.geo.get();
+				// 地理坐标地图与/api/map/bbox相同：在投影后的外接矩形中查找，再按经纬度筛选
+				auto [qx0, qy0, qx1, qy1] = geo ? geo->planarBox(box[0], box[1], box[2], box[3]) : box;
+				map.group_points.query(qx0, qy0, qx1, qy1, [&](const GroupPointIndex::Entry& e) {
+					if (!geo || geo->inside(e.x, e.y, box[0], box[1], box[2], box[3]))
+					{
+						options.groups.push_back(map.positionOf(e.value.entry));
+					}
+					return true;
+					});
+			}
+			else
+			{
+				throw std::invalid_argument("pareto search needs \"groups\" or \"box\"");
+			}
+			std::sort(options.groups.begin(), options.groups.end());
+			options.groups.erase(std::unique(options.groups.begin(), options.groups.end()), options.groups.end());
+			if (options.groups.empty())
+			{
+				throw std::invalid_argument("no house group in the region");
+			}
+			if (options.groups.size() > options.max_groups)
+			{
+				throw std::invalid_argument("too many house groups in the region: " + std::to_string(options.groups.size()));
+			}
+			return options;
+		}
+	};
+
+	/**
+	 * ParetoSearch，区域内房屋组接线方案的多目标搜索
+	 *
+	 * 每个房屋组的方案为(组前电线杆, 组后电线杆, 分割点)，电线杆取自两端点的k个最近电线杆。目标均为越小越好：
+	 * 区域内线缆总长、区域可用电线杆的最大负荷（含区域外房屋组按最优分割分到的负荷，A）、区域内各链末端电压降比例的最大值。
+	 * 每个房屋组的方案先在同一对电线杆内去掉被支配的分割点，各目标的贡献预先算好。
+	 * 全部组合数不超过max_evaluations时按第一个房屋组的方案分给各线程穷举，在时间预算内完成时结果为精确的Pareto前沿；
+	 * 否则各线程从不同权重下坐标下降得到的解出发做Pareto局部搜索：逐个展开存档中未展开的解，
+	 * 改变一个房屋组的方案，不被存档支配的邻居加入存档，存档都已展开时随机扰动一个解再下降。
+	 * 邻居只改变一个房屋组，线缆、负荷和电压降都增量求值。
+	 * 地理坐标地图的线缆长度和电压降按球面距离（米）计算，与/api/map/voltage一致
+	 */
+	class ParetoSearch {
+	public:
+		using Objectives = std::array<double, 3>;
+
+		ParetoSearch(const MapVersion& map, ParetoOptions options)
+			: map_{ map }, options_{ std::move(options) }
+		{
+		}
+
+		/**
+		 * 返回{"version", "groups", "infeasible", "exact", "evaluations", "shortest", "front"}，
+		 * shortest为每个房屋组都取线缆最短方案时的目标值，front按线缆总长排列，
+		 * 每项为{"cable", "max_pole_load", "max_drop_ratio", "assignment"}，
+		 * assignment中每项为{"index", "front_houses", "front", "back"}，front、back为电线杆ID，不供电的一端为null
+		 */
+		nlohmann::json run(size_t threads = std::thread::hardware_concurrency())
+		{
+			deadline_ = std::chrono::steady_clock::now() + options_.budget;
+			prepare();
+
+			nlohmann::json j;
+			j["version"] = map_.version;
+			j["groups"] = nlohmann::json::array();
+			for (const auto& group : groups_)
+			{
+				j["groups"].push_back(group.index);
+			}
+			j["infeasible"] = infeasible_;
+
+			Archive front;
+			size_t evaluations = 0;
+			auto exact = true;
+			Objectives shortest{};
+			if (!groups_.empty())
+			{
+				State seed{ *this };
+				shortest = seed.value();
+				exact = combinations() <= options_.max_evaluations;
+				std::vector<Archive> archives;
+				std::vector<size_t> counts;
+				if (exact)
+				{
+					const auto& first = groups_.front().options;
+					archives.resize(first.size());
+					counts.resize(first.size());
+					parallelFor(first.size(), [&](size_t o) { counts[o] = enumerate(static_cast<uint32_t>(o), seed, archives[o]); }, threads, 1);
+				}
+				else
+				{
+					auto tasks = std::max<size_t>(std::max<size_t>(threads, 1) * 2, 6);
+					archives.resize(tasks);
+					counts.resize(tasks);
+					parallelFor(tasks, [&](size_t t) { counts[t] = localSearch(t, tasks, seed, archives[t]); }, threads, 1);
+				}
+				for (size_t t = 0; t < archives.size(); ++t)
+				{
+					evaluations += counts[t];
+					for (auto& solution : archives[t].solutions)
+					{
+						front.offer(solution.value, [&] { return std::move(solution.choice); });
+					}
+				}
+				front.thin(options_.max_solutions);
+			}
+			j["exact"] = exact && !truncated_;
+			j["evaluations"] = evaluations;
+			j["shortest"] = objectivesJson(shortest);
+
+			std::sort(front.solutions.begin(), front.solutions.end(), [](const Solution& a, const Solution& b) { return a.value < b.value; });
+			auto& result = j["front"] = nlohmann::json::array();
+			for (const auto& solution : front.solutions)
+			{
+				auto s = objectivesJson(solution.value);
+				auto& assignment = s["assignment"] = nlohmann::json::array();
+				for (size_t g = 0; g < groups_.size(); ++g)
+				{
+					const auto& option = groups_[g].options[solution.choice[g]];
+					nlohmann::json a;
+					a["index"] = groups_[g].index;
+					a["front_houses"] = option.front_houses;
+					a["front"] = option.front_pole < 0 ? nlohmann::json() : nlohmann::json(poles_[option.front_pole]->id);
+					a["back"] = option.back_pole < 0 ? nlohmann::json() : nlohmann::json(poles_[option.back_pole]->id);
+					assignment.push_back(std::move(a));
+				}
+				result.push_back(std::move(s));
+			}
+			return j;
+		}
+
+	private:
+		/**
+		 * 房屋组的一个方案及其对各目标的贡献，电线杆为poles_中的下标，不供电的一端为-1
+		 */
+		struct Option {
+			int front_pole{ -1 };
+			int back_pole{ -1 };
+			size_t front_houses{};
+			double cable{};
+			double drop{};
+			double front_load{};
+			double back_load{};
+		};
+
+		struct Group {
+			size_t index;
+			std::vector<Option> options;
+		};
+
+		struct Solution {
+			std::vector<uint32_t> choice;
+			Objectives value;
+			bool explored{};
+		};
+
+		static bool dominates(const Objectives& a, const Objectives& b)
+		{
+			return a[0] <= b[0] && a[1] <= b[1] && a[2] <= b[2] && a != b;
+		}
+
+		/**
+		 * 互不支配的解的集合，目标值相同的解只保留一个
+		 */
+		struct Archive {
+			std::vector<Solution> solutions;
+
+			bool accepts(const Objectives& value) const
+			{
+				return std::none_of(solutions.begin(), solutions.end(), [&value](const Solution& s) { return s.value == value || dominates(s.value, value); });
+			}
+
+			// 不被支配时加入存档并移除被它支配的解，choice()只在加入时调用
+			template <typename Choice>
+			bool offer(const Objectives& value, Choice&& choice)
+			{
+				if (!accepts(value))
+				{
+					return false;
+				}
+				solutions.erase(std::remove_if(solutions.begin(), solutions.end(), [&value](const Solution& s) { return dominates(value, s.value); }), solutions.end());
+				solutions.push_back({ choice(), value });
+				return true;
+			}
+
+			// 超出上限时逐个移除拥挤距离最小的解，各目标的最优解不会被移除
+			void thin(size_t limit)
+			{
+				while (solutions.size() > limit)
+				{
+					std::vector<double> crowding(solutions.size());
+					std::vector<size_t> order(solutions.size());
+					for (size_t m = 0; m < 3; ++m)
+					{
+						for (size_t i = 0; i < order.size(); ++i)
+						{
+							order[i] = i;
+						}
+						std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return solutions[a].value[m] < solutions[b].value[m]; });
+						auto range = solutions[order.back()].value[m] - solutions[order.front()].value[m];
+						crowding[order.front()] = crowding[order.back()] = std::numeric_limits<double>::infinity();
+						for (size_t i = 1; i + 1 < order.size(); ++i)
+						{
+							crowding[order[i]] += range > 0 ? (solutions[order[i + 1]].value[m] - solutions[order[i - 1]].value[m]) / range : 0;
+						}
+					}
+					solutions.erase(solutions.begin() + (std::min_element(crowding.begin(), crowding.end()) - crowding.begin()));
+				}
+			}
+		};
+
+		/**
+		 * 一个完整方案及增量求值所需的汇总：各电线杆负荷、各房屋组电压降，
+		 * 以及负荷最大的几个电线杆和电压降最大的两个房屋组
+		 */
+		class State {
+		public:
+			// 每个房屋组取线缆最短的方案
+			explicit State(const ParetoSearch& search)
+				: search_{ &search }, choice_(search.groups_.size()), load_{ search.base_load_ }, drop_(search.groups_.size())
+			{
+				for (size_t g = 0; g < choice_.size(); ++g)
+				{
+					const auto& options = search.groups_[g].options;
+					choice_[g] = static_cast<uint32_t>(std::min_element(options.begin(), options.end(), [](const Option& a, const Option& b) { return a.cable < b.cable; }) - options.begin());
+					add(option(g), 1);
+				}
+				refresh();
+			}
+
+			const std::vector<uint32_t>& choice() const
+			{
+				return choice_;
+			}
+
+			Objectives value() const
+			{
+				return { cable_, top_load_.empty() ? 0 : top_load_.front().first, top_drop_[0].first };
+			}
+
+			const Option& option(size_t g) const
+			{
+				return search_->groups_[g].options[choice_[g]];
+			}
+
+			// 房屋组g改用方案o后的目标值，不修改状态
+			Objectives evaluate(size_t g, uint32_t o) const
+			{
+				const auto& from = option(g);
+				const auto& to = search_->groups_[g].options[o];
+				std::array<std::pair<int, double>, 4> changed{};
+				size_t count = 0;
+				auto change = [&](int pole, double delta) {
+					if (pole < 0)
+					{
+						return;
+					}
+					for (size_t i = 0; i < count; ++i)
+					{
+						if (changed[i].first == pole)
+						{
+							changed[i].second += delta;
+							return;
+						}
+					}
+					changed[count++] = { pole, load_[pole] + delta };
+				};
+				change(from.front_pole, -from.front_load);
+				change(from.back_pole, -from.back_load);
+				change(to.front_pole, to.front_load);
+				change(to.back_pole, to.back_load);
+
+				double max_load = 0;
+				for (const auto& [value, pole] : top_load_)
+				{
+					if (std::none_of(changed.begin(), changed.begin() + count, [pole = pole](const auto& c) { return c.first == pole; }))
+					{
+						max_load = value;
+						break;
+					}
+				}
+				for (size_t i = 0; i < count; ++i)
+				{
+					max_load = std::max(max_load, changed[i].second);
+				}
+				auto other_drop = top_drop_[0].second == g ? top_drop_[1].first : top_drop_[0].first;
+				return { cable_ - from.cable + to.cable, max_load, std::max(other_drop, to.drop) };
+			}
+
+			void apply(size_t g, uint32_t o)
+			{
+				add(option(g), -1);
+				choice_[g] = o;
+				add(option(g), 1);
+				refresh();
+			}
+
+		private:
+			// evaluate最多改变4个电线杆的负荷，保留负荷最大的5个即可求出其余电线杆的最大负荷
+			static constexpr size_t top_loads = 5;
+
+			void add(const Option& option, double sign)
+			{
+				cable_ += sign * option.cable;
+				if (option.front_pole >= 0)
+				{
+					load_[option.front_pole] += sign * option.front_load;
+				}
+				if (option.back_pole >= 0)
+				{
+					load_[option.back_pole] += sign * option.back_load;
+				}
+			}
+
+			void refresh()
+			{
+				top_load_.clear();
+				for (size_t p = 0; p < load_.size(); ++p)
+				{
+					top_load_.push_back({ load_[p], static_cast<int>(p) });
+				}
+				auto keep = std::min(top_loads, top_load_.size());
+				std::partial_sort(top_load_.begin(), top_load_.begin() + keep, top_load_.end(), std::greater<>{});
+				top_load_.resize(keep);
+
+				top_drop_ = { std::pair{ 0.0, choice_.size() }, std::pair{ 0.0, choice_.size() } };
+				for (size_t g = 0; g < choice_.size(); ++g)
+				{
+					drop_[g] = option(g).drop;
+					if (drop_[g] > top_drop_[0].first)
+					{
+						top_drop_[1] = top_drop_[0];
+						top_drop_[0] = { drop_[g], g };
+					}
+					else if (drop_[g] > top_drop_[1].first)
+					{
+						top_drop_[1] = { drop_[g], g };
+					}
+				}
+			}
+
+			const ParetoSearch* search_;
+			std::vector<uint32_t> choice_;
+			std::vector<double> load_;
+			std::vector<double> drop_;
+			double cable_{};
+			std::vector<std::pair<double, int>> top_load_;
+			std::array<std::pair<double, size_t>, 2> top_drop_{};
+		};
+
+		static nlohmann::json objectivesJson(const Objectives& value)
+		{
+			nlohmann::json j;
+			j["cable"] = value[0];
+			j["max_pole_load"] = value[1];
+			j["max_drop_ratio"] = value[2];
+			return j;
+		}
+
+		int poleIndex(const std::string& id)
+		{
+			auto [it, inserted] = pole_index_.try_emplace(id, static_cast<int>(poles_.size()));
+			if (inserted)
+			{
+				poles_.push_back(&map_.elec->at(id));
+			}
+			return it->second;
+		}
+
+		void prepare()
+		{
+			const auto& params = options_.electrical;
+			std::unordered_set<const GroupEntry*> region;
+			for (auto index : options_.groups)
+			{
+				checkDeadline();
+				const auto& entry = *map_.groups[index];
+				region.insert(&entry);
+				auto options = groupOptions(entry);
+				if (options.empty())
+				{
+					infeasible_.push_back(index);
+				}
+				else
+				{
+					groups_.push_back({ index, std::move(options) });
+				}
+			}
+
+			// 区域外的房屋组按最优分割分到候选电线杆的负荷，由倒排索引找出
+			base_load_.assign(poles_.size(), 0.0);
+			std::unordered_set<const GroupEntry*> outside;
+			for (size_t p = 0; p < poles_.size(); ++p)
+			{
+				if (auto served = map_.served.find(poles_[p]->id))
+				{
+					for (const auto& point : *served)
+					{
+						if (region.count(point.entry) || !outside.insert(point.entry).second)
+						{
+							continue;
+						}
+						const auto& entry = *point.entry;
+						auto split = bestSplit(entry);
+						if (!split.feasible)
+						{
+							continue;
+						}
+						const auto& houses = entry.group.house_poles;
+						double front_load = 0, back_load = 0;
+						for (size_t i = 0; i < houses.size(); ++i)
+						{
+							(i < split.front_houses ? front_load : back_load) += params.load(houses[i]);
+						}
+						if (split.front_houses > 0)
+						{
+							addBaseLoad(entry.front.elec_id, front_load);
+						}
+						if (split.front_houses < houses.size())
+						{
+							addBaseLoad(entry.back.elec_id, back_load);
+						}
+					}
+				}
+			}
+		}
+
+		void addBaseLoad(const std::string& id, double load)
+		{
+			if (auto it = pole_index_.find(id); it != pole_index_.end())
+			{
+				base_load_[it->second] += load;
+			}
+		}
+
+		/**
+		 * 房屋组的全部方案。到电线杆的距离为d时，前k户的组前链：
+		 * 线缆为d + front_lead + prefix[k - 1]，电压降为z·(d·Σload + Σload_j·(front_lead + prefix[j]))，
+		 * 后两项与d无关，按k预先累加；组后链对称
+		 */
+		std::vector<Option> groupOptions(const GroupEntry& entry)
+		{
+			const auto& params = options_.electrical;
+			const auto& group = entry.group;
+			const auto& houses = group.house_poles;
+			const auto n = houses.size();
+			std::vector<Option> options;
+			if (n == 0)
+			{
+				options.push_back({});
+				return options;
+			}
+
+			// 候选电线杆由平面索引查找，各段长度在地理坐标地图中按球面距离计算
+			const auto* geo = map_.geo.get();
+			auto length = [geo](const Hole& a, const Hole& b) { return geo ? geo->length(a, b) : distance(a, b); };
+			std::vector<double> geodesic_prefix;
+			if (geo)
+			{
+				geodesic_prefix.resize(n);
+				for (size_t i = 1; i < n; ++i)
+				{
+					geodesic_prefix[i] = geodesic_prefix[i - 1] + length(houses[i - 1], houses[i]);
+				}
+			}
+			const auto& prefix = geo ? geodesic_prefix : entry.prefix;
+
+			auto candidates = [&](const Hole& endpoint, bool valid) {
+				std::vector<std::pair<int, double>> poles;
+				if (valid)
+				{
+					for (const auto& [distance, e] : map_.elec->index.nearest(endpoint.x, endpoint.y, options_.candidates))
+					{
+						poles.push_back({ poleIndex(e->value), geo ? length(map_.elec->at(e->value), endpoint) : distance });
+					}
+				}
+				return poles;
+			};
+			auto front_poles = candidates(group.group_front_pole, group.group_front_valid);
+			auto back_poles = candidates(group.group_back_pole, group.group_back_valid);
+
+			auto front_lead = length(group.group_front_pole, houses.front());
+			auto back_lead = length(group.group_back_pole, houses.back());
+			// front_*[k]为前k户，back_*[k]为第k户及以后
+			std::vector<double> front_load(n + 1), front_moment(n + 1), back_load(n + 1), back_moment(n + 1);
+			for (size_t k = 0; k < n; ++k)
+			{
+				auto load = params.load(houses[k]);
+				front_load[k + 1] = front_load[k] + load;
+				front_moment[k + 1] = front_moment[k] + load * (front_lead + prefix[k]);
+			}
+			for (auto k = n; k-- > 0;)
+			{
+				auto load = params.load(houses[k]);
+				back_load[k] = back_load[k + 1] + load;
+				back_moment[k] = back_moment[k + 1] + load * (back_lead + prefix[n - 1] - prefix[k]);
+			}
+			auto front_z = params.impedance(group.group_front_pole) / params.voltage;
+			auto back_z = params.impedance(group.group_back_pole) / params.voltage;
+
+			const std::pair<int, double> none{ -1, 0.0 };
+			for (auto f : front_poles.empty() ? std::vector{ none } : front_poles)
+			{
+				for (auto b : back_poles.empty() ? std::vector{ none } : back_poles)
+				{
+					checkDeadline();
+					auto begin = options.size();
+					for (size_t k = 0; k <= n; ++k)
+					{
+						if ((k > 0 && f.first < 0) || (k < n && b.first < 0))
+						{
+							continue;
+						}
+						Option option;
+						option.front_houses = k;
+						if (k > 0)
+						{
+							option.front_pole = f.first;
+							option.front_load = front_load[k];
+							option.cable += f.second + front_lead + prefix[k - 1];
+							option.drop = front_z * (f.second * front_load[k] + front_moment[k]);
+						}
+						if (k < n)
+						{
+							option.back_pole = b.first;
+							option.back_load = back_load[k];
+							option.cable += b.second + back_lead + prefix[n - 1] - prefix[k];
+							option.drop = std::max(option.drop, back_z * (b.second * back_load[k] + back_moment[k]));
+						}
+						options.push_back(option);
+					}
+					prune(options, begin, f.first, b.first);
+				}
+			}
+			// 只用一端供电的方案在不同的另一端候选下重复出现
+			std::sort(options.begin(), options.end(), [](const Option& a, const Option& b) {
+				return std::tie(a.front_pole, a.back_pole, a.front_houses) < std::tie(b.front_pole, b.back_pole, b.front_houses);
+				});
+			options.erase(std::unique(options.begin(), options.end(), [](const Option& a, const Option& b) {
+				return a.front_pole == b.front_pole && a.back_pole == b.back_pole && a.front_houses == b.front_houses;
+				}), options.end());
+			return options;
+		}
+
+		// 同一对电线杆下，线缆、电压降和两端负荷都不优的分割点不会出现在Pareto前沿中。
+		// 负荷非负，组前的负荷随分割点不减、组后的负荷不增，两个分割点的负荷可比时两根电线杆上的负荷都相等，
+		// 因此按负荷分类，每类按(线缆, 电压降)排序后扫描一遍，O(m log m)
+		static void prune(std::vector<Option>& options, size_t begin, int front, int back)
+		{
+			auto load = [](const Option& o, int pole) {
+				return pole < 0 ? 0.0 : (o.front_pole == pole ? o.front_load : 0) + (o.back_pole == pole ? o.back_load : 0);
+			};
+			auto key = [&](const Option& o) { return std::tuple{ load(o, front), load(o, back), o.cable, o.drop }; };
+			std::sort(options.begin() + begin, options.end(), [&](const Option& a, const Option& b) { return key(a) < key(b); });
+			auto kept = begin;
+			auto best_drop = std::numeric_limits<double>::infinity();
+			std::tuple<double, double> loads{ -1.0, -1.0 };
+			for (auto i = begin; i < options.size();)
+			{
+				// [i, k)的负荷、线缆和电压降都相同，只会被排在前面、负荷相同的点支配
+				auto [front_load, back_load, cable, drop] = key(options[i]);
+				auto k = i + 1;
+				while (k < options.size() && key(options[k]) == std::tuple{ front_load, back_load, cable, drop })
+				{
+					++k;
+				}
+				if (loads != std::tuple{ front_load, back_load })
+				{
+					loads = { front_load, back_load };
+					best_drop = std::numeric_limits<double>::infinity();
+				}
+				if (drop < best_drop)
+				{
+					for (; i < k; ++i)
+					{
+						options[kept++] = options[i];
+					}
+					best_drop = drop;
+				}
+				i = k;
+			}
+			options.resize(kept);
+		}
+
+		double combinations() const
+		{
+			double count = 1;
+			for (const auto& group : groups_)
+			{
+				count *= static_cast<double>(group.options.size());
+			}
+			return count;
+		}
+
+		// 方案在搜索开始前全部生成，房屋组很长时也可能超出时间预算，这时没有可返回的解
+		void checkDeadline() const
+		{
+			if (std::chrono::steady_clock::now() >= deadline_)
+			{
+				throw std::invalid_argument("pareto search budget exhausted while preparing group options, reduce candidates or the region");
+			}
+		}
+
+		bool expired(size_t evaluations) const
+		{
+			return evaluations % 256 == 0 && std::chrono::steady_clock::now() >= deadline_;
+		}
+
+		// 第一个房屋组取方案first，穷举其余房屋组的所有组合。
+		// 每个first是一个任务，房屋组少、方案多时任务内的求值很少，开始前也检查时间预算
+		size_t enumerate(uint32_t first, const State& seed, Archive& archive) const
+		{
+			if (std::chrono::steady_clock::now() >= deadline_)
+			{
+				truncated_ = true;
+				return 0;
+			}
+			auto state = seed;
+			state.apply(0, first);
+			const auto count = groups_.size();
+			size_t evaluations = 0;
+			std::vector<uint32_t> digits(count);
+			for (size_t g = 1; g < count; ++g)
+			{
+				state.apply(g, 0);
+			}
+			digits[0] = first;
+			for (;;)
+			{
+				archive.offer(state.value(), [&] { return state.choice(); });
+				if (expired(++evaluations))
+				{
+					truncated_ = true;
+					return evaluations;
+				}
+				// 里程表式进位，每次只改变少数房屋组
+				auto g = count;
+				while (--g > 0)
+				{
+					if (++digits[g] < groups_[g].options.size())
+					{
+						state.apply(g, digits[g]);
+						break;
+					}
+					digits[g] = 0;
+					state.apply(g, 0);
+				}
+				if (g == 0)
+				{
+					return evaluations;
+				}
+			}
+		}
+
+		// 按权重w（各目标除以最短方案的值）的加权和做坐标下降
+		void descend(State& state, const Objectives& w, const Objectives& scale, size_t& evaluations, size_t limit) const
+		{
+			auto scalar = [&](const Objectives& v) { return w[0] * v[0] / scale[0] + w[1] * v[1] / scale[1] + w[2] * v[2] / scale[2]; };
+			for (auto improved = true; improved && evaluations < limit;)
+			{
+				improved = false;
+				for (size_t g = 0; g < groups_.size() && evaluations < limit; ++g)
+				{
+					auto best = scalar(state.value());
+					auto best_option = state.choice()[g];
+					for (uint32_t o = 0; o < groups_[g].options.size(); ++o)
+					{
+						if (o == state.choice()[g])
+						{
+							continue;
+						}
+						auto value = scalar(state.evaluate(g, o));
+						++evaluations;
+						if (value < best - 1e-12 * std::abs(best))
+						{
+							best = value;
+							best_option = o;
+						}
+					}
+					if (best_option != state.choice()[g])
+					{
+						state.apply(g, best_option);
+						improved = true;
+					}
+				}
+				if (std::chrono::steady_clock::now() >= deadline_)
+				{
+					break;
+				}
+			}
+		}
+
+		size_t localSearch(size_t task, size_t tasks, const State& shortest, Archive& archive) const
+		{
+			std::mt19937_64 random{ task + 1 };
+			const auto limit = std::max<size_t>(options_.max_evaluations / tasks, 1);
+			auto scale = shortest.value();
+			for (auto& s : scale)
+			{
+				s = std::max(s, 1e-9);
+			}
+			auto weight = [&random](size_t task) {
+				// 前几个任务偏重单个目标，其余权重随机
+				if (task < 3)
+				{
+					Objectives w{ 1e-3, 1e-3, 1e-3 };
+					w[task] = 1;
+					return w;
+				}
+				std::uniform_real_distribution<double> uniform{ 0, 1 };
+				return Objectives{ uniform(random), uniform(random), uniform(random) };
+			};
+
+			size_t evaluations = 0;
+			auto state = shortest;
+			archive.offer(state.value(), [&] { return state.choice(); });
+			descend(state, weight(std::min<size_t>(task, 3)), scale, evaluations, limit);
+			archive.offer(state.value(), [&] { return state.choice(); });
+
+			const auto cap = options_.max_solutions * 4;
+			while (evaluations < limit && std::chrono::steady_clock::now() < deadline_)
+			{
+				auto& solutions = archive.solutions;
+				auto next = std::find_if(solutions.begin(), solutions.end(), [](const Solution& s) { return !s.explored; });
+				if (next == solutions.end())
+				{
+					// 存档都已展开：随机扰动一个解的几个房屋组，再按随机权重下降
+					state = shortest;
+					const auto& base = solutions[random() % solutions.size()].choice;
+					for (size_t g = 0; g < groups_.size(); ++g)
+					{
+						if (base[g] != state.choice()[g])
+						{
+							state.apply(g, base[g]);
+						}
+					}
+					for (size_t r = 1 + random() % std::min<size_t>(3, groups_.size()); r-- > 0;)
+					{
+						auto g = random() % groups_.size();
+						state.apply(g, static_cast<uint32_t>(random() % groups_[g].options.size()));
+					}
+					descend(state, weight(3), scale, evaluations, limit);
+					archive.offer(state.value(), [&] { return state.choice(); });
+					++evaluations;
+					continue;
+				}
+
+				next->explored = true;
+				auto choice = next->choice;
+				state = shortest;
+				for (size_t g = 0; g < groups_.size(); ++g)
+				{
+					if (choice[g] != state.choice()[g])
+					{
+						state.apply(g, choice[g]);
+					}
+				}
+				for (size_t g = 0; g < groups_.size() && evaluations < limit; ++g)
+				{
+					for (uint32_t o = 0; o < groups_[g].options.size(); ++o)
+					{
+						if (o == choice[g])
+						{
+							continue;
+						}
+						auto value = state.evaluate(g, o);
+						archive.offer(value, [&] { auto c = choice; c[g] = o; return c; });
+						if (expired(++evaluations))
+						{
+							return evaluations;
+						}
+					}
+				}
+				if (archive.solutions.size() > cap)
+				{
+					archive.thin(cap);
+				}
+			}
+			return evaluations;
+		}
+
+		const MapVersion& map_;
+		ParetoOptions options_;
+		std::chrono::steady_clock::time_point deadline_;
+		/**
+		 * 穷举因时间预算中止，结果不再精确
+		 */
+		mutable std::atomic<bool> truncated_{};
+		std::vector<Group> groups_;
+		std::vector<size_t> infeasible_;
+		std::vector<const Hole*> poles_;
+		std::unordered_map<std::string, int> pole_index_;
+		std::vector<double> base_load_;
+	};
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include "map_store.h"
+#include "group_split.h"
+#include "auto_group.h"
+#include "parallel_for.h"
+
+namespace ohtoai {
+	/**
+	 * PolePlanner，选择新增电线杆的位置，使所有房屋组最优分割的线缆总长最小
+	 *
+	 * 离散k中位（设施选址）的贪心算法，候选位置为所有有效的组端点。
+	 * 每个房屋组的线缆只依赖两端点到最近电线杆的距离（SplitCost），
+	 * 候选c只影响端点落在以其当前距离为半径的圆内的房屋组，由候选的空间索引找出。
+	 * 先并行求出每个房屋组受哪些候选影响及各自的节省量，累加为每个候选的总节省；
+	 * 每选定一个候选，只重新计算它影响到的房屋组，并从相关候选的节省中增减差值。
+	 * 地图没有电线杆时贪心的第一步需要比较所有候选对所有房屋组，改为把有效端点
+	 * 沿希尔伯特曲线均分为count段，各取几何中位数作为电线杆位置。
+	 */
+	class PolePlanner {
+	public:
+		PolePlanner(const MapVersion& map, size_t count)
+			: map_{ map }, count_{ count }
+		{
+		}
+
+		/**
+		 * 返回{"version", "cable_before", "cable_after", "saving", "unserved", "poles"}，
+		 * poles按选定顺序，每项为{"x", "y", "group", "endpoint", "saving", "groups"}，
+		 * group和endpoint为该位置所在的组端点，saving为该电线杆带来的边际节省，groups为改接到它的房屋组数。
+		 * unserved为没有有效端点、无法供电的房屋组数，不计入线缆总长。
+		 * 地图没有电线杆时cable_before和各电线杆的saving为null。
+		 * 地理坐标地图的x、y为经纬度，选址在投影平面上进行，报告的线缆长度和节省按球面距离（米）计算
+		 */
+		nlohmann::json run(size_t threads = std::thread::hardware_concurrency())
+		{
+			prepare();
+			nlohmann::json j;
+			j["version"] = map_.version;
+			auto& poles = j["poles"] = nlohmann::json::array();
+
+			j["cable_before"] = before_;
+			if (map_.elec->poles.empty() && !candidates_.empty())
+			{
+				for (const auto& [x, y] : seed())
+				{
+					poles.push_back(place(x, y, inf, std::nullopt));
+				}
+			}
+			influence(threads);
+			while (poles.size() < count_)
+			{
+				auto best = std::max_element(gain_.begin(), gain_.end());
+				if (best == gain_.end() || *best <= 1e-9)
+				{
+					break;
+				}
+				auto c = static_cast<size_t>(best - gain_.begin());
+				auto saving = *best;
+				poles.push_back(place(candidates_[c].x, candidates_[c].y, saving, c));
+				poles.back()["group"] = candidates_[c].group;
+				poles.back()["endpoint"] = candidates_[c].front ? "front" : "back";
+			}
+			j["cable_after"] = total();
+			j["saving"] = before_ - j["cable_after"].get<double>();
+			j["unserved"] = unserved_;
+			return j;
+		}
+
+	private:
+		struct Candidate {
+			double x;
+			double y;
+			size_t group;
+			bool front;
+		};
+
+		struct GroupState {
+			SplitCost cost;
+			double front_distance;
+			double back_distance;
+			/**
+			 * 比当前电线杆更近的候选及在其处新增电线杆的节省量（可能为0）
+			 */
+			std::vector<std::pair<size_t, double>> helped_by;
+			/**
+			 * 地理坐标地图：按球面距离的SplitCost，和两端点当前分到的电线杆
+			 */
+			SplitCost geodesic;
+			const Hole* front_pole{};
+			const Hole* back_pole{};
+		};
+
+		static constexpr double inf = std::numeric_limits<double>::infinity();
+
+		void prepare()
+		{
+			const auto& groups = map_.groups;
+			states_.resize(groups.size());
+			for (size_t i = 0; i < groups.size(); ++i)
+			{
+				const auto& entry = *groups[i];
+				const auto& group = entry.group;
+				auto& state = states_[i];
+				state.cost = splitCost(group, entry.prefix);
+				state.front_distance = group.group_front_valid && !entry.front.elec_id.empty() ? entry.front.distance : inf;
+				state.back_distance = group.group_back_valid && !entry.back.elec_id.empty() ? entry.back.distance : inf;
+				if (map_.geo)
+				{
+					state.geodesic = splitCost(group, *map_.geo);
+					state.front_pole = entry.front.elec_id.empty() ? nullptr : &map_.elec->at(entry.front.elec_id);
+					state.back_pole = entry.back.elec_id.empty() ? nullptr : &map_.elec->at(entry.back.elec_id);
+				}
+				if (state.cost.empty)
+				{
+					continue;
+				}
+				if (!group.group_front_valid && !group.group_back_valid)
+				{
+					++unserved_;
+					continue;
+				}
+				if (group.group_front_valid)
+				{
+					candidates_.push_back({ group.group_front_pole.x, group.group_front_pole.y, i, true });
+				}
+				if (group.group_back_valid)
+				{
+					candidates_.push_back({ group.group_back_pole.x, group.group_back_pole.y, i, false });
+				}
+			}
+			std::vector<PointIndex<size_t>::Entry> entries;
+			entries.reserve(candidates_.size());
+			for (size_t c = 0; c < candidates_.size(); ++c)
+			{
+				entries.push_back({ candidates_[c].x, candidates_[c].y, c });
+			}
+			index_ = PointIndex<size_t>{ std::move(entries) };
+			before_ = total();
+		}
+
+		bool served(size_t i) const
+		{
+			const auto& group = map_.groups[i]->group;
+			return !states_[i].cost.empty && (group.group_front_valid || group.group_back_valid);
+		}
+
+		// 报告的线缆长度，地理坐标地图按球面距离重新计算
+		double cable(size_t i) const
+		{
+			const auto& state = states_[i];
+			if (!map_.geo)
+			{
+				return state.cost(state.front_distance, state.back_distance);
+			}
+			const auto& group = map_.groups[i]->group;
+			auto lead = [this](double distance, const Hole& endpoint, const Hole* pole) {
+				return std::isinf(distance) ? inf : map_.geo->length(endpoint, *pole);
+			};
+			return state.geodesic(lead(state.front_distance, group.group_front_pole, state.front_pole), lead(state.back_distance, group.group_back_pole, state.back_pole));
+		}
+
+		double total() const
+		{
+			double sum = 0;
+			for (size_t i = 0; i < states_.size(); ++i)
+			{
+				if (served(i))
+				{
+					sum += cable(i);
+				}
+			}
+			return sum;
+		}
+
+		// 重新计算房屋组i的helped_by：端点圆内的候选及节省量。节省为0的也要记录，
+		// 否则在其处新增电线杆后该组的距离变化不会被更新
+		void evaluate(size_t i)
+		{
+			auto& state = states_[i];
+			state.helped_by.clear();
+			if (!served(i))
+			{
+				return;
+			}
+			const auto& group = map_.groups[i]->group;
+			auto current = state.cost(state.front_distance, state.back_distance);
+			std::vector<size_t> near;
+			for (const auto& [endpoint, valid, radius] : { std::tuple{ &group.group_front_pole, group.group_front_valid, state.front_distance },
+				std::tuple{ &group.group_back_pole, group.group_back_valid, state.back_distance } })
+			{
+				if (!valid || radius <= 0)
+				{
+					continue;
+				}
+				index_.query(endpoint->x - radius, endpoint->y - radius, endpoint->x + radius, endpoint->y + radius, [&](const PointIndex<size_t>::Entry& e) {
+					if (std::hypot(e.x - endpoint->x, e.y - endpoint->y) < radius)
+					{
+						near.push_back(e.value);
+					}
+					return true;
+					});
+			}
+			std::sort(near.begin(), near.end());
+			near.erase(std::unique(near.begin(), near.end()), near.end());
+			for (auto c : near)
+			{
+				auto saving = current - state.cost(std::min(state.front_distance, distanceTo(group.group_front_pole, c)),
+					std::min(state.back_distance, distanceTo(group.group_back_pole, c)));
+				state.helped_by.push_back({ c, saving });
+			}
+		}
+
+		double distanceTo(const Hole& endpoint, size_t c) const
+		{
+			return std::hypot(candidates_[c].x - endpoint.x, candidates_[c].y - endpoint.y);
+		}
+
+		// 并行求每个房屋组受影响的候选，再累加为每个候选的总节省和它影响的房屋组
+		void influence(size_t threads)
+		{
+			parallelFor(states_.size(), [this](size_t i) { evaluate(i); }, threads, 64);
+			gain_.assign(candidates_.size(), 0.0);
+			helps_.assign(candidates_.size(), {});
+			for (size_t i = 0; i < states_.size(); ++i)
+			{
+				for (const auto& [c, saving] : states_[i].helped_by)
+				{
+					gain_[c] += saving;
+					helps_[c].push_back(i);
+				}
+			}
+		}
+
+		// 在(x, y)新增电线杆，更新受影响的房屋组和候选的节省量。
+		// 位于候选c时只有helps_[c]中的房屋组可能受影响，否则检查所有房屋组
+		nlohmann::json place(double x, double y, double saving, std::optional<size_t> c)
+		{
+			auto& pole = placed_.emplace_back();
+			pole.x = x;
+			pole.y = y;
+			size_t moved = 0;
+			// 地理坐标地图的节省为受影响房屋组按球面距离的线缆差，没有原电线杆时saving为无穷大，不需要计算
+			double geodesic_saving = 0;
+			auto measure = map_.geo && std::isfinite(saving);
+			auto update = [&](size_t i) {
+				auto& state = states_[i];
+				const auto& group = map_.groups[i]->group;
+				auto front = group.group_front_valid ? std::min(state.front_distance, distance(group.group_front_pole, pole)) : inf;
+				auto back = group.group_back_valid ? std::min(state.back_distance, distance(group.group_back_pole, pole)) : inf;
+				if (front == state.front_distance && back == state.back_distance)
+				{
+					return;
+				}
+				++moved;
+				auto before = measure ? cable(i) : 0.0;
+				state.front_pole = front == state.front_distance ? state.front_pole : &pole;
+				state.back_pole = back == state.back_distance ? state.back_pole : &pole;
+				state.front_distance = front;
+				state.back_distance = back;
+				geodesic_saving += measure ? before - cable(i) : 0.0;
+				// 尚未求出各候选的节省量（放置第一个电线杆时）
+				if (gain_.empty())
+				{
+					return;
+				}
+				for (const auto& [candidate, old] : state.helped_by)
+				{
+					gain_[candidate] -= old;
+				}
+				evaluate(i);
+				// 距离只减不增，新的影响范围是原来的子集，helps_中多余的房屋组在更新时不会变化而被跳过
+				for (const auto& [candidate, now] : state.helped_by)
+				{
+					gain_[candidate] += now;
+				}
+			};
+			if (c)
+			{
+				for (auto i : helps_[*c])
+				{
+					update(i);
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < states_.size(); ++i)
+				{
+					if (served(i))
+					{
+						update(i);
+					}
+				}
+			}
+			nlohmann::json j;
+			std::tie(j["x"], j["y"]) = map_.geo ? map_.geo->unproject(x, y) : std::pair{ x, y };
+			j["saving"] = measure ? geodesic_saving : saving;
+			j["groups"] = moved;
+			return j;
+		}
+
+		// 有效端点沿希尔伯特曲线均分为count_段后各段的几何中位数（Weiszfeld迭代）
+		std::vector<std::pair<double, double>> seed() const
+		{
+			auto min_x = candidates_.front().x, max_x = min_x;
+			auto min_y = candidates_.front().y, max_y = min_y;
+			for (const auto& c : candidates_)
+			{
+				min_x = std::min(min_x, c.x);
+				max_x = std::max(max_x, c.x);
+				min_y = std::min(min_y, c.y);
+				max_y = std::max(max_y, c.y);
+			}
+			auto scale = 65535 / std::max({ max_x - min_x, max_y - min_y, 1e-9 });
+			std::vector<std::pair<uint64_t, size_t>> keys(candidates_.size());
+			for (size_t c = 0; c < candidates_.size(); ++c)
+			{
+				keys[c] = { hilbertIndex(static_cast<uint32_t>((candidates_[c].x - min_x) * scale), static_cast<uint32_t>((candidates_[c].y - min_y) * scale)), c };
+			}
+			std::sort(keys.begin(), keys.end());
+
+			std::vector<std::pair<double, double>> centers;
+			auto count = std::min(count_, keys.size());
+			for (size_t k = 0; k < count; ++k)
+			{
+				auto begin = keys.size() * k / count, end = keys.size() * (k + 1) / count;
+				double x = 0, y = 0;
+				for (auto i = begin; i < end; ++i)
+				{
+					x += candidates_[keys[i].second].x / (end - begin);
+					y += candidates_[keys[i].second].y / (end - begin);
+				}
+				for (int iteration = 0; iteration < 50; ++iteration)
+				{
+					double wx = 0, wy = 0, w = 0;
+					for (auto i = begin; i < end; ++i)
+					{
+						const auto& c = candidates_[keys[i].second];
+						auto d = std::max(std::hypot(c.x - x, c.y - y), 1e-9);
+						wx += c.x / d;
+						wy += c.y / d;
+						w += 1 / d;
+					}
+					x = wx / w;
+					y = wy / w;
+				}
+				centers.push_back({ x, y });
+			}
+			return centers;
+		}
+
+		const MapVersion& map_;
+		size_t count_;
+		std::vector<GroupState> states_;
+		std::vector<Candidate> candidates_;
+		PointIndex<size_t> index_;
+		std::vector<double> gain_;
+		std::vector<std::vector<size_t>> helps_;
+		/**
+		 * 已放置的电线杆，GroupState中的指针指向其中的元素
+		 */
+		std::deque<Hole> placed_;
+		double before_{};
+		size_t unserved_{};
+	};
+}
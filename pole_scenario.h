@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include "map_store.h"
+#include "group_split.h"
+
+namespace ohtoai {
+	/**
+	 * PoleScenario，对电线杆的假设修改，只计算影响而不写回地图
+	 *
+	 * 修改为{"op": "add", "pole": Hole}、{"op": "remove", "id"}或{"op": "move", "id", "x", "y"}，
+	 * move相当于删除后在新位置加入同一ID的电线杆。
+	 * 只有以下端点的最近电线杆可能变化：分到被删除电线杆的端点，
+	 * 以及分到新电线杆在Delaunay三角剖分中邻点（Voronoi单元会被分走一部分的电线杆）的端点。
+	 * 后者由地图版本保存的三角剖分在新电线杆的冲突区域中找出，再经倒排索引取得房屋组，
+	 * 只对这些房屋组重新分配端点并按SplitCost计算线缆。
+	 * 地理坐标地图中修改给出的坐标为经纬度，端点分配在投影平面上比较，报告的线缆长度和距离按球面距离（米）计算
+	 */
+	class PoleScenario {
+	public:
+		PoleScenario(const MapVersion& map, const nlohmann::json& edits)
+			: map_{ map }
+		{
+			const auto& elec = *map_.elec;
+			for (const auto& edit : edits)
+			{
+				auto op = edit.at("op").get<std::string>();
+				if (op == "remove" || op == "move")
+				{
+					auto id = edit.at("id").get<std::string>();
+					const auto& pole = elec.at(id);
+					if (!removed_.insert(id).second)
+					{
+						throw std::invalid_argument("elec pole edited twice: " + id);
+					}
+					if (op == "move")
+					{
+						auto moved = pole;
+						auto x = edit.at("x").get<double>(), y = edit.at("y").get<double>();
+						std::tie(moved.x, moved.y) = map_.geo ? map_.geo->project(x, y) : std::pair{ x, y };
+						added_.push_back(std::move(moved));
+					}
+				}
+				else if (op == "add")
+				{
+					auto pole = toPlanar(map_.geo.get(), edit.at("pole").get<Hole>());
+					if (elec.by_id.count(pole.id))
+					{
+						throw std::invalid_argument("duplicate elec pole id: " + pole.id);
+					}
+					added_.push_back(std::move(pole));
+				}
+				else
+				{
+					throw std::invalid_argument("unknown scenario op: " + op);
+				}
+			}
+			std::unordered_set<std::string> added_ids;
+			for (const auto& pole : added_)
+			{
+				if (!added_ids.insert(pole.id).second)
+				{
+					throw std::invalid_argument("elec pole added twice: " + pole.id);
+				}
+			}
+		}
+
+		/**
+		 * 返回{"version", "cable_before", "cable_after", "delta", "unserved_before", "unserved_after",
+		 * "touched_poles", "recomputed_groups", "groups"}，
+		 * groups只列出端点分配变化的房屋组，每项为{"index", "before", "after", "front", "back"}，
+		 * front、back为{"from", "to", "distance"}，分配不变的一端为null。
+		 * 线缆总长为各房屋组最优分割之和，没有可用端点的房屋组计入unserved
+		 */
+		nlohmann::json run() const
+		{
+			const auto& elec = *map_.elec;
+
+			// Voronoi邻域：被删除的电线杆，和新电线杆插入后的Delaunay邻点
+			std::unordered_set<std::string> touched{ removed_.begin(), removed_.end() };
+			for (const auto& pole : added_)
+			{
+				auto nearest = elec.index.nearest(pole.x, pole.y, 1);
+				if (nearest.empty())
+				{
+					continue;
+				}
+				for (auto i : elec.delaunay->insertionNeighbors(pole.x, pole.y, elec.by_id.at(nearest.front().second->value)))
+				{
+					touched.insert(elec.poles[i].id);
+				}
+			}
+
+			std::vector<const GroupEntry*> groups;
+			std::unordered_set<const GroupEntry*> seen;
+			for (const auto& id : touched)
+			{
+				if (auto served = map_.served.find(id))
+				{
+					for (const auto& point : *served)
+					{
+						if (seen.insert(point.entry).second)
+						{
+							groups.push_back(point.entry);
+						}
+					}
+				}
+			}
+			// 地图原来没有电线杆时所有房屋组都要重新分配
+			if (elec.poles.empty())
+			{
+				for (const auto& entry : map_.groups)
+				{
+					groups.push_back(entry.get());
+				}
+			}
+
+			nlohmann::json j;
+			j["version"] = map_.version;
+			const auto& [before, unserved_before] = baseline(map_);
+
+			double delta = 0;
+			int unserved_delta = 0;
+			std::vector<std::pair<size_t, nlohmann::json>> changed;
+			for (const auto* entry : groups)
+			{
+				const auto& group = entry->group;
+				auto front = group.group_front_valid ? reassign(group.group_front_pole, entry->front) : entry->front;
+				auto back = group.group_back_valid ? reassign(group.group_back_pole, entry->back) : entry->back;
+				if (same(front, entry->front) && same(back, entry->back))
+				{
+					continue;
+				}
+				auto old_cost = cable(map_, *entry, entry->front, entry->back);
+				auto new_cost = cable(map_, *entry, front, back, added_);
+				unserved_delta += (std::isinf(new_cost) ? 1 : 0) - (std::isinf(old_cost) ? 1 : 0);
+				delta += (std::isinf(new_cost) ? 0 : new_cost) - (std::isinf(old_cost) ? 0 : old_cost);
+
+				nlohmann::json g;
+				auto index = map_.positionOf(entry);
+				g["index"] = index;
+				g["before"] = old_cost;
+				g["after"] = new_cost;
+				g["front"] = change(group.group_front_pole, entry->front, front);
+				g["back"] = change(group.group_back_pole, entry->back, back);
+				changed.push_back({ index, std::move(g) });
+			}
+			std::sort(changed.begin(), changed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			auto& result = j["groups"] = nlohmann::json::array();
+			for (auto& [index, g] : changed)
+			{
+				result.push_back(std::move(g));
+			}
+
+			j["cable_before"] = before;
+			j["cable_after"] = before + delta;
+			j["delta"] = delta;
+			j["unserved_before"] = unserved_before;
+			j["unserved_after"] = static_cast<int>(unserved_before) + unserved_delta;
+			j["touched_poles"] = touched.size();
+			j["recomputed_groups"] = groups.size();
+			return j;
+		}
+
+	private:
+		static constexpr double inf = std::numeric_limits<double>::infinity();
+
+		static double usable(bool valid, const EndpointAssignment& assignment)
+		{
+			return valid && !assignment.elec_id.empty() ? assignment.distance : inf;
+		}
+
+		// 电线杆ID对应的电线杆，新增和移动后的电线杆优先
+		static const Hole& pole(const MapVersion& map, const std::string& id, const std::vector<Hole>& added)
+		{
+			auto it = std::find_if(added.begin(), added.end(), [&id](const Hole& p) { return p.id == id; });
+			return it != added.end() ? *it : map.elec->at(id);
+		}
+
+		// 房屋组在给定端点分配下的线缆总长，没有可用端点时为无穷大。
+		// 原分配不带added：移动的电线杆ID不变，原分配指向的是它原来的位置
+		static double cable(const MapVersion& map, const GroupEntry& entry, const EndpointAssignment& front, const EndpointAssignment& back, const std::vector<Hole>& added = {})
+		{
+			const auto& group = entry.group;
+			if (!map.geo)
+			{
+				return splitCost(group, entry.prefix)(usable(group.group_front_valid, front), usable(group.group_back_valid, back));
+			}
+			auto lead = [&](bool valid, const Hole& endpoint, const EndpointAssignment& assignment) {
+				return valid && !assignment.elec_id.empty() ? map.geo->length(endpoint, pole(map, assignment.elec_id, added)) : inf;
+			};
+			return splitCost(group, *map.geo)(lead(group.group_front_valid, group.group_front_pole, front), lead(group.group_back_valid, group.group_back_pole, back));
+		}
+
+		// 修改前的线缆总长与请求无关，同一版本只计算一次，之后每个请求只计算受影响房屋组的增量
+		static const MapVersion::CableTotal& baseline(const MapVersion& map)
+		{
+			std::call_once(map.cable_total_once, [&map] {
+				std::vector<double> costs(map.groups.size());
+				parallelFor(map.groups.size(), [&](size_t i) {
+					const auto& entry = *map.groups[i];
+					costs[i] = cable(map, entry, entry.front, entry.back);
+					}, std::thread::hardware_concurrency(), 256);
+				MapVersion::CableTotal total;
+				for (auto group_cost : costs)
+				{
+					if (std::isinf(group_cost))
+					{
+						++total.unserved;
+					}
+					else
+					{
+						total.cable += group_cost;
+					}
+				}
+				map.cable_total = total;
+				});
+			return map.cable_total;
+		}
+
+		// 端点在修改后的最近电线杆：原有未删除的电线杆和新电线杆中较近的一个
+		EndpointAssignment reassign(const Hole& endpoint, const EndpointAssignment& current) const
+		{
+			EndpointAssignment assignment;
+			if (!current.elec_id.empty() && !removed_.count(current.elec_id))
+			{
+				assignment = current;
+			}
+			else
+			{
+				auto kept = [this](const PointIndex<std::string>::Entry& e) { return removed_.count(e.value) == 0; };
+				auto nearest = map_.elec->index.nearest(endpoint.x, endpoint.y, 1, kept);
+				if (!nearest.empty())
+				{
+					assignment.elec_id = nearest.front().second->value;
+					assignment.distance = nearest.front().first;
+				}
+			}
+			for (const auto& pole : added_)
+			{
+				auto d = distance(endpoint, pole);
+				if (assignment.elec_id.empty() || d < assignment.distance)
+				{
+					assignment.elec_id = pole.id;
+					assignment.distance = d;
+				}
+			}
+			return assignment;
+		}
+
+		// 移动的电线杆ID不变，还要比较距离
+		static bool same(const EndpointAssignment& a, const EndpointAssignment& b)
+		{
+			return a.elec_id == b.elec_id && a.distance == b.distance;
+		}
+
+		nlohmann::json change(const Hole& endpoint, const EndpointAssignment& from, const EndpointAssignment& to) const
+		{
+			if (same(from, to))
+			{
+				return nullptr;
+			}
+			nlohmann::json j;
+			j["from"] = from.elec_id.empty() ? nlohmann::json() : nlohmann::json(from.elec_id);
+			j["to"] = to.elec_id.empty() ? nlohmann::json() : nlohmann::json(to.elec_id);
+			if (to.elec_id.empty())
+			{
+				j["distance"] = nullptr;
+			}
+			else
+			{
+				j["distance"] = map_.geo ? map_.geo->length(endpoint, pole(map_, to.elec_id, added_)) : to.distance;
+			}
+			return j;
+		}
+
+		const MapVersion& map_;
+		std::unordered_set<std::string> removed_;
+		std::vector<Hole> added_;
+	};
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include "map_store.h"
+
+namespace ohtoai {
+	/**
+	 * Precomputer，地图提交后在后台预先计算所有住户的solution
+	 *
+	 * 使用固定数量的工作线程，前台请求进行时暂停让出CPU；
+	 * 同一地图重新提交时取消旧版本的任务。
+	 */
+	class Precomputer {
+	public:
+		using Task = std::function<void(std::shared_ptr<const MapVersion>, const std::string& house_id)>;
+
+		/**
+		 * 前台请求的作用域，存在期间后台任务让出
+		 */
+		class ForegroundScope {
+		public:
+			explicit ForegroundScope(std::atomic<int>& counter) : counter_{ counter } { ++counter_; }
+			~ForegroundScope() { --counter_; }
+			ForegroundScope(const ForegroundScope&) = delete;
+			ForegroundScope& operator=(const ForegroundScope&) = delete;
+		private:
+			std::atomic<int>& counter_;
+		};
+
+		Precomputer(size_t worker_count, Task task)
+			: task_{ std::move(task) }
+		{
+			for (size_t i = 0; i < (worker_count ? worker_count : 1); ++i)
+			{
+				workers_.emplace_back([this] { workerLoop(); });
+			}
+		}
+
+		~Precomputer()
+		{
+			{
+				std::lock_guard lock{ mutex_ };
+				stopping_ = true;
+			}
+			cv_.notify_all();
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+		}
+
+		// 为地图的指定版本安排预计算，同名地图未完成的任务会被取消
+		void schedule(const std::string& name, std::shared_ptr<const MapVersion> map)
+		{
+			auto job = std::make_shared<Job>();
+			job->name = name;
+			job->map = std::move(map);
+			for (const auto& entry : job->map->groups)
+			{
+				for (const auto& hp : entry->group.house_poles)
+				{
+					job->houses.push_back(hp.id);
+				}
+			}
+
+			std::lock_guard lock{ mutex_ };
+			if (auto it = jobs_.find(name); it != jobs_.end())
+			{
+				it->second->cancelled = true;
+			}
+			jobs_[name] = job;
+			queue_.push_back(job);
+			cv_.notify_all();
+		}
+
+		// 取消地图的预计算任务，地图被替换时调用
+		void cancel(const std::string& name)
+		{
+			std::lock_guard lock{ mutex_ };
+			if (auto it = jobs_.find(name); it != jobs_.end())
+			{
+				it->second->cancelled = true;
+			}
+		}
+
+		// 查询预计算进度，没有任务时抛出std::out_of_range
+		nlohmann::json progress(const std::string& name) const
+		{
+			std::shared_ptr<Job> job;
+			{
+				std::lock_guard lock{ mutex_ };
+				job = jobs_.at(name);
+			}
+			nlohmann::json j;
+			j["version"] = job->map->version;
+			j["total"] = job->houses.size();
+			j["done"] = job->done.load();
+			j["failed"] = job->failed.load();
+			if (job->done + job->failed == job->houses.size())
+			{
+				j["state"] = "done";
+			}
+			else if (job->cancelled)
+			{
+				j["state"] = "cancelled";
+			}
+			else
+			{
+				j["state"] = "running";
+			}
+			return j;
+		}
+
+		ForegroundScope foreground()
+		{
+			return ForegroundScope{ foreground_ };
+		}
+
+	private:
+		struct Job {
+			std::string name;
+			std::shared_ptr<const MapVersion> map;
+			std::vector<std::string> houses;
+			std::atomic<size_t> next{};
+			std::atomic<size_t> done{};
+			std::atomic<size_t> failed{};
+			std::atomic<bool> cancelled{};
+		};
+
+		void workerLoop()
+		{
+			for (;;)
+			{
+				std::shared_ptr<Job> job;
+				size_t index{};
+				{
+					std::unique_lock lock{ mutex_ };
+					cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+					if (stopping_)
+					{
+						return;
+					}
+					job = queue_.front();
+					index = job->next++;
+					// 任务已分配完或被取消，移出队列
+					if (index >= job->houses.size() || job->cancelled)
+					{
+						queue_.pop_front();
+						continue;
+					}
+				}
+
+				yieldToForeground();
+				if (job->cancelled)
+				{
+					continue;
+				}
+				try
+				{
+					task_(job->map, job->houses[index]);
+					++job->done;
+				}
+				catch (...)
+				{
+					++job->failed;
+				}
+			}
+		}
+
+		// 有前台请求时等待，最多等待一小段时间，避免持续的前台流量让后台任务饿死
+		void yieldToForeground() const
+		{
+			using namespace std::chrono_literals;
+			for (auto waited = 0ms; foreground_ > 0 && waited < 50ms && !stopping_; waited += 1ms)
+			{
+				std::this_thread::sleep_for(1ms);
+			}
+		}
+
+		Task task_;
+		std::vector<std::thread> workers_;
+		mutable std::mutex mutex_;
+		std::condition_variable cv_;
+		std::map<std::string, std::shared_ptr<Job>> jobs_;
+		std::deque<std::shared_ptr<Job>> queue_;
+		std::atomic<int> foreground_{};
+		std::atomic<bool> stopping_{};
+	};
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+namespace ohtoai {
+	/**
+	 * ShardedMap，按key哈希分片的只读哈希表
+	 *
+	 * 复制时只复制各分片的指针；通过Writer修改时，每个分片在首次写入时才复制，
+	 * 未修改的分片在新旧版本之间共享。
+	 */
+	template <typename Key, typename Value, size_t ShardCount = 64>
+	class ShardedMap {
+	public:
+		using Shard = std::unordered_map<Key, Value>;
+
+		ShardedMap()
+		{
+			for (auto& shard : shards_)
+			{
+				shard = std::make_shared<const Shard>();
+			}
+		}
+
+		// 查找，不存在时返回nullptr
+		const Value* find(const Key& key) const
+		{
+			const auto& shard = *shards_[shardOf(key)];
+			auto it = shard.find(key);
+			return it == shard.end() ? nullptr : &it->second;
+		}
+
+		size_t size() const
+		{
+			size_t size{};
+			for (const auto& shard : shards_)
+			{
+				size += shard->size();
+			}
+			return size;
+		}
+
+		/**
+		 * Writer，写时复制的修改器
+		 */
+		class Writer {
+		public:
+			explicit Writer(ShardedMap& target) : target_{ target } {}
+
+			Value& operator[](const Key& key)
+			{
+				return shard(key)[key];
+			}
+
+			// key不存在时插入，返回是否插入
+			bool emplace(const Key& key, Value value)
+			{
+				auto index = shardOf(key);
+				if (target_.shards_[index]->count(key) > 0)
+				{
+					return false;
+				}
+				return shard(key).emplace(key, std::move(value)).second;
+			}
+
+			Value* find(const Key& key)
+			{
+				auto index = shardOf(key);
+				if (target_.shards_[index]->count(key) == 0)
+				{
+					return nullptr;
+				}
+				return &shard(key).at(key);
+			}
+
+			void erase(const Key& key)
+			{
+				auto index = shardOf(key);
+				if (target_.shards_[index]->count(key) > 0)
+				{
+					shard(key).erase(key);
+				}
+			}
+
+		private:
+			Shard& shard(const Key& key)
+			{
+				auto index = shardOf(key);
+				if (!owned_[index])
+				{
+					auto copy = std::make_shared<Shard>(*target_.shards_[index]);
+					owned_[index] = copy.get();
+					target_.shards_[index] = std::move(copy);
+				}
+				return *owned_[index];
+			}
+
+			ShardedMap& target_;
+			std::array<Shard*, ShardCount> owned_{};
+		};
+
+	private:
+		static size_t shardOf(const Key& key)
+		{
+			return std::hash<Key>{}(key) % ShardCount;
+		}
+
+		std::array<std::shared_ptr<const Shard>, ShardCount> shards_;
+	};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
+
+namespace ohtoai {
+	/**
+	 * SingleFlight，合并相同key的并发计算
+	 *
+	 * 同一时刻同一key只有一个调用者真正执行计算，其余调用者等待并共享其结果（或异常）。
+	 * 计算完成后立即移除，之后的调用会重新计算，结果的复用交给各自的缓存。
+	 */
+	template <typename Key, typename Value>
+	class SingleFlight {
+	public:
+		template <typename Fn>
+		Value run(const Key& key, Fn&& fn)
+		{
+			std::unique_lock lock{ mutex_ };
+			if (auto it = calls_.find(key); it != calls_.end())
+			{
+				auto future = it->second;
+				lock.unlock();
+				++coalesced_;
+				return future.get();
+			}
+
+			std::promise<Value> promise;
+			calls_.emplace(key, promise.get_future().share());
+			lock.unlock();
+
+			try
+			{
+				auto value = fn();
+				promise.set_value(value);
+				finish(key);
+				return value;
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+				finish(key);
+				throw;
+			}
+		}
+
+		// 正在进行中的计算数量
+		size_t inFlight() const
+		{
+			std::lock_guard lock{ mutex_ };
+			return calls_.size();
+		}
+
+		// 因等待他人结果而省去的计算次数
+		uint64_t coalesced() const
+		{
+			return coalesced_.load();
+		}
+
+	private:
+		void finish(const Key& key)
+		{
+			std::lock_guard lock{ mutex_ };
+			calls_.erase(key);
+		}
+
+		mutable std::mutex mutex_;
+		std::map<Key, std::shared_future<Value>> calls_;
+		std::atomic<uint64_t> coalesced_{};
+	};
+}
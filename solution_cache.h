@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace ohtoai {
+	/**
+	 * SolutionCache，按(版本号, 住户ID, 编码)缓存序列化后的solution响应
+	 *
+	 * 版本号取住户所在房屋组的stamp，编码区分同一结果的不同序列化格式。按key哈希分片，每个分片独立加锁并按字节数做LRU淘汰。
+	 * 地图替换或房屋组修改后stamp变化，旧条目不会再被命中，随LRU自然淘汰。
+	 */
+	class SolutionCache {
+	public:
+		using Body = std::shared_ptr<const std::string>;
+
+		explicit SolutionCache(size_t capacity_bytes, size_t shard_count = 16)
+			: shard_capacity_{ capacity_bytes / (shard_count ? shard_count : 1) }
+		{
+			shards_.resize(shard_count ? shard_count : 1);
+			for (auto& shard : shards_)
+			{
+				shard = std::make_unique<Shard>();
+			}
+		}
+
+		// 查找缓存，未命中时返回nullptr
+		Body get(uint64_t version, const std::string& house_id, unsigned encoding)
+		{
+			Key key{ version, house_id, encoding };
+			auto& shard = shardOf(key);
+			std::lock_guard lock{ shard.mutex };
+			auto it = shard.index.find(key);
+			if (it == shard.index.end())
+			{
+				++misses_;
+				return nullptr;
+			}
+			++hits_;
+			// 移到链表头部，表示最近使用
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+			return it->second->second;
+		}
+
+		// 是否已缓存，不影响命中统计和LRU顺序
+		bool contains(uint64_t version, const std::string& house_id, unsigned encoding) const
+		{
+			Key key{ version, house_id, encoding };
+			auto& shard = shardOf(key);
+			std::lock_guard lock{ shard.mutex };
+			return shard.index.count(key) > 0;
+		}
+
+		void put(uint64_t version, const std::string& house_id, unsigned encoding, Body body)
+		{
+			Key key{ version, house_id, encoding };
+			auto size = entrySize(key, *body);
+			if (size > shard_capacity_)
+			{
+				return;
+			}
+
+			auto& shard = shardOf(key);
+			std::lock_guard lock{ shard.mutex };
+			if (auto it = shard.index.find(key); it != shard.index.end())
+			{
+				shard.bytes -= entrySize(it->first, *it->second->second);
+				shard.lru.erase(it->second);
+				shard.index.erase(it);
+			}
+			shard.lru.emplace_front(key, std::move(body));
+			shard.index.emplace(std::move(key), shard.lru.begin());
+			shard.bytes += size;
+
+			while (shard.bytes > shard_capacity_)
+			{
+				auto& [old_key, old_body] = shard.lru.back();
+				shard.bytes -= entrySize(old_key, *old_body);
+				shard.index.erase(old_key);
+				shard.lru.pop_back();
+				++evictions_;
+			}
+		}
+
+		nlohmann::json stats() const
+		{
+			size_t entries{}, bytes{};
+			for (const auto& shard : shards_)
+			{
+				std::lock_guard lock{ shard->mutex };
+				entries += shard->index.size();
+				bytes += shard->bytes;
+			}
+			nlohmann::json j;
+			j["hits"] = hits_.load();
+			j["misses"] = misses_.load();
+			j["evictions"] = evictions_.load();
+			j["entries"] = entries;
+			j["bytes"] = bytes;
+			j["capacity"] = shard_capacity_ * shards_.size();
+			j["shards"] = shards_.size();
+			return j;
+		}
+
+	private:
+		struct Key {
+			uint64_t version;
+			std::string house_id;
+			unsigned encoding;
+
+			bool operator==(const Key& other) const
+			{
+				return version == other.version && house_id == other.house_id && encoding == other.encoding;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const
+			{
+				return std::hash<std::string>{}(key.house_id) ^ (std::hash<uint64_t>{}(key.version * 8 + key.encoding) * 0x9e3779b97f4a7c15ull);
+			}
+		};
+
+		struct Shard {
+			mutable std::mutex mutex;
+			std::list<std::pair<Key, Body>> lru;
+			std::unordered_map<Key, std::list<std::pair<Key, Body>>::iterator, KeyHash> index;
+			size_t bytes{};
+		};
+
+		// 估算条目占用：key、响应体以及链表和哈希表节点
+		static size_t entrySize(const Key& key, const std::string& body)
+		{
+			return key.house_id.size() + body.size() + 96;
+		}
+
+		Shard& shardOf(const Key& key) const
+		{
+			return *shards_[KeyHash{}(key) % shards_.size()];
+		}
+
+		std::vector<std::unique_ptr<Shard>> shards_;
+		size_t shard_capacity_;
+		std::atomic<uint64_t> hits_{}, misses_{}, evictions_{};
+	};
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+namespace ohtoai {
+	/**
+	 * PointIndex，点四叉树
+	 *
+	 * 结点只读且由shared_ptr持有：复制索引只复制根指针，
+	 * 插入和删除只复制从根到目标叶子的路径，其余结点在新旧版本间共享。
+	 */
+	template <typename T>
+	class PointIndex {
+	public:
+		struct Entry {
+			double x;
+			double y;
+			T value;
+		};
+
+		PointIndex() = default;
+
+		// 批量构建
+		explicit PointIndex(std::vector<Entry> entries)
+		{
+			if (entries.empty())
+			{
+				return;
+			}
+			auto min_x = entries.front().x, max_x = min_x;
+			auto min_y = entries.front().y, max_y = min_y;
+			for (const auto& e : entries)
+			{
+				if (!std::isfinite(e.x) || !std::isfinite(e.y))
+				{
+					throw std::invalid_argument("non-finite point coordinate");
+				}
+				min_x = std::min(min_x, e.x);
+				max_x = std::max(max_x, e.x);
+				min_y = std::min(min_y, e.y);
+				max_y = std::max(max_y, e.y);
+			}
+			auto size = std::max({ max_x - min_x, max_y - min_y, 1.0 }) * 1.0001;
+			box_ = Box{ min_x, min_y, min_x + size, min_y + size };
+			root_ = build(entries.begin(), entries.end(), box_, 0);
+		}
+
+		size_t size() const
+		{
+			return root_ ? root_->count : 0;
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		void insert(Entry entry)
+		{
+			// 非有限坐标永远不在范围内，扩大根结点的循环不会结束
+			if (!std::isfinite(entry.x) || !std::isfinite(entry.y))
+			{
+				throw std::invalid_argument("non-finite point coordinate");
+			}
+			if (!root_)
+			{
+				box_ = Box{ entry.x - 0.5, entry.y - 0.5, entry.x + 0.5, entry.y + 0.5 };
+			}
+			// 点在范围外时将根结点作为子结点向该方向扩大一倍
+			while (!box_.contains(entry.x, entry.y))
+			{
+				auto size = box_.max_x - box_.min_x;
+				auto grow_left = entry.x < box_.min_x;
+				auto grow_down = entry.y < box_.min_y;
+				Box box{
+					grow_left ? box_.min_x - size : box_.min_x,
+					grow_down ? box_.min_y - size : box_.min_y,
+					grow_left ? box_.max_x : box_.max_x + size,
+					grow_down ? box_.max_y : box_.max_y + size,
+				};
+				if (root_)
+				{
+					auto node = std::make_shared<Node>();
+					node->leaf = false;
+					node->count = root_->count;
+					node->children[(grow_left ? 1 : 0) | (grow_down ? 2 : 0)] = root_;
+					root_ = node;
+				}
+				box_ = box;
+			}
+			root_ = insertInto(root_, box_, std::move(entry), 0);
+		}
+
+		// 删除坐标和值都相同的一个点，返回是否找到
+		bool erase(double x, double y, const T& value)
+		{
+			if (!root_ || !box_.contains(x, y))
+			{
+				return false;
+			}
+			auto [node, found] = eraseFrom(root_, box_, x, y, value);
+			if (found)
+			{
+				root_ = node;
+			}
+			return found;
+		}
+
+		// 遍历矩形范围内的点，fn返回false时停止
+		template <typename Fn>
+		void query(double min_x, double min_y, double max_x, double max_y, Fn&& fn) const
+		{
+			if (root_)
+			{
+				queryIn(*root_, box_, Box{ min_x, min_y, max_x, max_y }, fn);
+			}
+		}
+
+		// 距离(x, y)最近的k个点，按距离升序，只考虑accept返回true的点
+		template <typename Accept>
+		std::vector<std::pair<double, const Entry*>> nearest(double x, double y, size_t k, Accept&& accept) const
+		{
+			std::vector<std::pair<double, const Entry*>> result;
+			if (!root_ || k == 0)
+			{
+				return result;
+			}
+
+			// 结果堆：距离最大的在堆顶
+			auto farther = [](const auto& a, const auto& b) { return a.first < b.first; };
+			std::priority_queue<std::pair<double, const Entry*>, std::vector<std::pair<double, const Entry*>>, decltype(farther)> best{ farther };
+			// 待访问结点：离查询点最近的优先
+			using Pending = std::pair<double, std::pair<const Node*, Box>>;
+			auto closer = [](const Pending& a, const Pending& b) { return a.first > b.first; };
+			std::priority_queue<Pending, std::vector<Pending>, decltype(closer)> pending{ closer };
+			pending.push({ box_.distance2(x, y), { root_.get(), box_ } });
+
+			while (!pending.empty())
+			{
+				auto [d2, item] = pending.top();
+				pending.pop();
+				if (best.size() == k && d2 > best.top().first)
+				{
+					break;
+				}
+				auto [node, box] = item;
+				if (node->leaf)
+				{
+					for (const auto& e : node->entries)
+					{
+						if (!accept(e))
+						{
+							continue;
+						}
+						auto ed2 = (e.x - x) * (e.x - x) + (e.y - y) * (e.y - y);
+						if (best.size() < k)
+						{
+							best.push({ ed2, &e });
+						}
+						else if (ed2 < best.top().first)
+						{
+							best.pop();
+							best.push({ ed2, &e });
+						}
+					}
+					continue;
+				}
+				for (size_t q = 0; q < 4; ++q)
+				{
+					if (node->children[q])
+					{
+						auto child_box = box.quadrant(q);
+						pending.push({ child_box.distance2(x, y), { node->children[q].get(), child_box } });
+					}
+				}
+			}
+
+			result.resize(best.size());
+			for (auto i = result.size(); i-- > 0; best.pop())
+			{
+				result[i] = { std::sqrt(best.top().first), best.top().second };
+			}
+			return result;
+		}
+
+		std::vector<std::pair<double, const Entry*>> nearest(double x, double y, size_t k) const
+		{
+			return nearest(x, y, k, [](const Entry&) { return true; });
+		}
+
+	private:
+		static constexpr size_t leaf_capacity = 8;
+		static constexpr int max_depth = 32;
+
+		struct Box {
+			double min_x{}, min_y{}, max_x{}, max_y{};
+
+			bool contains(double x, double y) const
+			{
+				return x >= min_x && x < max_x && y >= min_y && y < max_y;
+			}
+
+			bool intersects(const Box& other) const
+			{
+				return min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+			}
+
+			double midX() const { return (min_x + max_x) / 2; }
+			double midY() const { return (min_y + max_y) / 2; }
+
+			// 象限编号：bit0为x方向高半边，bit1为y方向高半边
+			size_t quadrantOf(double x, double y) const
+			{
+				return (x >= midX() ? 1 : 0) | (y >= midY() ? 2 : 0);
+			}
+
+			Box quadrant(size_t q) const
+			{
+				return Box{
+					q & 1 ? midX() : min_x,
+					q & 2 ? midY() : min_y,
+					q & 1 ? max_x : midX(),
+					q & 2 ? max_y : midY(),
+				};
+			}
+
+			double distance2(double x, double y) const
+			{
+				auto dx = std::max({ min_x - x, 0.0, x - max_x });
+				auto dy = std::max({ min_y - y, 0.0, y - max_y });
+				return dx * dx + dy * dy;
+			}
+		};
+
+		struct Node {
+			bool leaf{ true };
+			size_t count{};
+			std::array<std::shared_ptr<const Node>, 4> children{};
+			std::vector<Entry> entries;
+		};
+
+		using Iterator = typename std::vector<Entry>::iterator;
+
+		static std::shared_ptr<const Node> build(Iterator begin, Iterator end, const Box& box, int depth)
+		{
+			auto node = std::make_shared<Node>();
+			node->count = static_cast<size_t>(end - begin);
+			if (node->count <= leaf_capacity || depth >= max_depth)
+			{
+				node->entries.assign(std::make_move_iterator(begin), std::make_move_iterator(end));
+				return node;
+			}
+			node->leaf = false;
+			// 按象限原地划分：先按y划分，再在两半中按x划分
+			auto mid_y = std::partition(begin, end, [&box](const Entry& e) { return e.y < box.midY(); });
+			auto low_x = [&box](const Entry& e) { return e.x < box.midX(); };
+			auto mid_low = std::partition(begin, mid_y, low_x);
+			auto mid_high = std::partition(mid_y, end, low_x);
+			std::array<std::pair<Iterator, Iterator>, 4> ranges{ {
+				{ begin, mid_low }, { mid_low, mid_y }, { mid_y, mid_high }, { mid_high, end } } };
+			for (size_t q = 0; q < 4; ++q)
+			{
+				if (ranges[q].first != ranges[q].second)
+				{
+					node->children[q] = build(ranges[q].first, ranges[q].second, box.quadrant(q), depth + 1);
+				}
+			}
+			return node;
+		}
+
+		static std::shared_ptr<const Node> insertInto(const std::shared_ptr<const Node>& node, const Box& box, Entry&& entry, int depth)
+		{
+			auto copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+			++copy->count;
+			if (copy->leaf)
+			{
+				copy->entries.push_back(std::move(entry));
+				if (copy->entries.size() > leaf_capacity && depth < max_depth)
+				{
+					auto entries = std::move(copy->entries);
+					return build(entries.begin(), entries.end(), box, depth);
+				}
+				return copy;
+			}
+			auto q = box.quadrantOf(entry.x, entry.y);
+			copy->children[q] = insertInto(copy->children[q], box.quadrant(q), std::move(entry), depth + 1);
+			return copy;
+		}
+
+		static std::pair<std::shared_ptr<const Node>, bool> eraseFrom(const std::shared_ptr<const Node>& node, const Box& box, double x, double y, const T& value)
+		{
+			if (!node)
+			{
+				return { node, false };
+			}
+			if (node->leaf)
+			{
+				auto it = std::find_if(node->entries.begin(), node->entries.end(), [&](const Entry& e) {
+					return e.x == x && e.y == y && e.value == value;
+					});
+				if (it == node->entries.end())
+				{
+					return { node, false };
+				}
+				if (node->count == 1)
+				{
+					return { nullptr, true };
+				}
+				auto copy = std::make_shared<Node>(*node);
+				copy->entries.erase(copy->entries.begin() + (it - node->entries.begin()));
+				--copy->count;
+				return { copy, true };
+			}
+
+			auto q = box.quadrantOf(x, y);
+			auto [child, found] = eraseFrom(node->children[q], box.quadrant(q), x, y, value);
+			if (!found)
+			{
+				return { node, false };
+			}
+			auto copy = std::make_shared<Node>(*node);
+			copy->children[q] = child;
+			--copy->count;
+			// 点数足够少时合并为叶子
+			if (copy->count <= leaf_capacity)
+			{
+				auto leaf = std::make_shared<Node>();
+				leaf->count = copy->count;
+				collect(*copy, leaf->entries);
+				return { leaf, true };
+			}
+			return { copy, true };
+		}
+
+		static void collect(const Node& node, std::vector<Entry>& out)
+		{
+			if (node.leaf)
+			{
+				out.insert(out.end(), node.entries.begin(), node.entries.end());
+				return;
+			}
+			for (const auto& child : node.children)
+			{
+				if (child)
+				{
+					collect(*child, out);
+				}
+			}
+		}
+
+		template <typename Fn>
+		static bool queryIn(const Node& node, const Box& box, const Box& range, Fn& fn)
+		{
+			if (node.leaf)
+			{
+				for (const auto& e : node.entries)
+				{
+					if (e.x >= range.min_x && e.x <= range.max_x && e.y >= range.min_y && e.y <= range.max_y && !fn(e))
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+			for (size_t q = 0; q < 4; ++q)
+			{
+				auto child_box = box.quadrant(q);
+				if (node.children[q] && child_box.intersects(range) && !queryIn(*node.children[q], child_box, range, fn))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		std::shared_ptr<const Node> root_;
+		Box box_;
+	};
+}
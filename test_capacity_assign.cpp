@@ -0,0 +1,183 @@
+// 带容量约束的全局分配与穷举最优解的对比测试。
+// 不属于vcxproj的构建，单独编译运行，例如：
+//   g++ -std=c++17 -O2 -I3rd/inc test_capacity_assign.cpp -o test_capacity_assign -pthread
+//   ./test_capacity_assign [cases]
+// 随机生成小地图：每组一户时CapacityAssigner的结果必须与穷举的最优值相等；
+// 每组户数不同时结果必须满足容量约束，且不优于穷举的最优值。有不符合的情况时返回非0
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+#include "capacity_assign.h"
+
+namespace {
+	using namespace ohtoai;
+
+	struct Case {
+		MapInfo map;
+		std::vector<double> capacity;
+		double unassigned_cost{};
+	};
+
+	Hole hole(std::string id, double x, double y)
+	{
+		return Hole{ std::move(id), x, y, nlohmann::json::object() };
+	}
+
+	Case generate(std::mt19937& rng, bool unit)
+	{
+		std::uniform_real_distribution<double> coord(0, 100);
+		std::uniform_int_distribution<int> pole_count(1, 4), group_count(2, 6), capacity(1, 3), houses(1, 3), coin(0, 3);
+		Case c;
+		auto poles = pole_count(rng);
+		for (int p = 0; p < poles; ++p)
+		{
+			c.map.elec_poles.push_back(hole("e" + std::to_string(p), coord(rng), coord(rng)));
+			c.capacity.push_back(capacity(rng) * (unit ? 1 : 2));
+		}
+		auto groups = group_count(rng);
+		for (int g = 0; g < groups; ++g)
+		{
+			HouseGroup group;
+			auto prefix = "g" + std::to_string(g);
+			group.group_front_pole = hole(prefix + "f", coord(rng), coord(rng));
+			group.group_back_pole = hole(prefix + "b", coord(rng), coord(rng));
+			// 至少一端有效
+			auto valid = coin(rng);
+			group.group_front_valid = valid != 1;
+			group.group_back_valid = valid != 2;
+			auto n = unit ? 1 : houses(rng);
+			for (int k = 0; k < n; ++k)
+			{
+				group.house_poles.push_back(hole(prefix + "h" + std::to_string(k), coord(rng), coord(rng)));
+			}
+			c.map.house_groups.push_back(std::move(group));
+		}
+		c.unassigned_cost = std::uniform_real_distribution<double>(20, 200)(rng);
+		return c;
+	}
+
+	// 穷举每个房屋组的选择（不分配或任一电线杆，取较近的有效端点）下满足容量的最小总费用
+	double bruteForce(const Case& c)
+	{
+		const auto& groups = c.map.house_groups;
+		const auto& poles = c.map.elec_poles;
+		const auto options = poles.size() + 1;
+		std::vector<std::vector<double>> cost(groups.size(), std::vector<double>(options, std::numeric_limits<double>::infinity()));
+		for (size_t g = 0; g < groups.size(); ++g)
+		{
+			const auto& group = groups[g];
+			for (size_t p = 0; p < poles.size(); ++p)
+			{
+				if (c.capacity[p] < group.house_poles.size())
+				{
+					continue;
+				}
+				if (group.group_front_valid)
+				{
+					cost[g][p] = std::min(cost[g][p], distance(group.group_front_pole, poles[p]));
+				}
+				if (group.group_back_valid)
+				{
+					cost[g][p] = std::min(cost[g][p], distance(group.group_back_pole, poles[p]));
+				}
+			}
+			cost[g][poles.size()] = c.unassigned_cost;
+		}
+
+		auto best = std::numeric_limits<double>::infinity();
+		std::vector<size_t> choice(groups.size());
+		for (;;)
+		{
+			std::vector<double> load(poles.size());
+			double total = 0;
+			for (size_t g = 0; g < groups.size(); ++g)
+			{
+				total += cost[g][choice[g]];
+				if (choice[g] < poles.size())
+				{
+					load[choice[g]] += static_cast<double>(groups[g].house_poles.size());
+				}
+			}
+			auto fits = true;
+			for (size_t p = 0; p < poles.size(); ++p)
+			{
+				fits = fits && load[p] <= c.capacity[p];
+			}
+			if (fits)
+			{
+				best = std::min(best, total);
+			}
+			size_t g = 0;
+			while (g < groups.size() && ++choice[g] == options)
+			{
+				choice[g++] = 0;
+			}
+			if (g == groups.size())
+			{
+				return best;
+			}
+		}
+	}
+
+	// 运行CapacityAssigner，返回总费用（含不分配的代价）；超出容量时返回NaN
+	double solve(const Case& c, bool& exact)
+	{
+		auto map = MapVersion::build(c.map, 1);
+		CapacityAssignOptions options;
+		options.candidates = c.map.elec_poles.size();
+		options.unassigned_cost = c.unassigned_cost;
+		for (size_t p = 0; p < c.capacity.size(); ++p)
+		{
+			options.capacity[c.map.elec_poles[p].id] = c.capacity[p];
+		}
+		auto j = CapacityAssigner{ *map, options }.run();
+		exact = j.at("exact").get<bool>();
+		for (const auto& pole : j.at("poles"))
+		{
+			if (pole.at("load").get<double>() > pole.at("capacity").get<double>())
+			{
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+		}
+		return j.at("total_distance").get<double>() + c.unassigned_cost * j.at("unassigned").size();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const auto cases = argc > 1 ? std::atoi(argv[1]) : 2000;
+	std::mt19937 rng{ 20261019 };
+	int failed = 0, exact_cases = 0, heuristic_cases = 0;
+	double worst_gap = 0;
+	for (int t = 0; t < cases; ++t)
+	{
+		auto unit = t % 2 == 0;
+		auto c = generate(rng, unit);
+		auto optimum = bruteForce(c);
+		bool exact{};
+		auto result = solve(c, exact);
+		auto tolerance = 1e-9 * (1 + optimum);
+		auto ok = !std::isnan(result) && result >= optimum - tolerance && (!unit || (exact && result <= optimum + tolerance));
+		if (!ok)
+		{
+			std::printf("case %d (%s): result %.6f optimum %.6f exact %d\n", t, unit ? "unit" : "weighted", result, optimum, exact ? 1 : 0);
+			++failed;
+		}
+		if (unit)
+		{
+			++exact_cases;
+		}
+		else
+		{
+			++heuristic_cases;
+			worst_gap = std::max(worst_gap, (result - optimum) / std::max(optimum, 1e-9));
+		}
+	}
+	std::printf("unit-load cases %d, weighted cases %d, failed %d, worst weighted gap %.2f%%\n", exact_cases, heuristic_cases, failed, worst_gap * 100);
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "group_split.h"
+
+namespace ohtoai {
+	/**
+	 * 电压降计算参数
+	 */
+	struct VoltageParams {
+		/**
+		 * 电线杆处的额定电压（V）
+		 */
+		double voltage{ 220.0 };
+		/**
+		 * 每单位长度线缆的回路电阻、电抗（欧姆，含往返两根导线），地理坐标地图的单位长度为米
+		 */
+		double resistance{ 1e-3 };
+		double reactance{ 0.0 };
+		double power_factor{ 1.0 };
+		/**
+		 * 允许的最大电压降占额定电压的比例
+		 */
+		double max_drop{ 0.05 };
+		/**
+		 * 没有单独给出负荷的住户的电流（A）
+		 */
+		double default_load{ 10.0 };
+		/**
+		 * 住户ID到电流（A）的附表，优先于住户extra中的"load"
+		 */
+		std::unordered_map<std::string, double> loads;
+
+		/**
+		 * 由请求json读取，缺省的字段取默认值。负荷附表中不存在的住户抛出std::out_of_range，非法参数抛出std::invalid_argument
+		 */
+		static VoltageParams fromJson(const nlohmann::json& j, const MapVersion& map)
+		{
+			VoltageParams params;
+			params.voltage = j.value("voltage", params.voltage);
+			params.resistance = j.value("resistance", params.resistance);
+			params.reactance = j.value("reactance", params.reactance);
+			params.power_factor = j.value("power_factor", params.power_factor);
+			params.max_drop = j.value("max_drop", params.max_drop);
+			params.default_load = j.value("default_load", params.default_load);
+			if (!(params.voltage > 0) || !(params.resistance >= 0) || !(params.reactance >= 0)
+				|| !(params.power_factor > 0 && params.power_factor <= 1) || !(params.max_drop >= 0) || !(params.default_load >= 0))
+			{
+				throw std::invalid_argument("invalid voltage drop parameters");
+			}
+			if (j.contains("loads"))
+			{
+				for (const auto& [id, load] : j.at("loads").items())
+				{
+					map.findHouse(id);
+					params.loads[id] = checkedLoad(load.get<double>(), id);
+				}
+			}
+			return params;
+		}
+
+		/**
+		 * 单位长度的等效阻抗：R·cosφ + X·sinφ，电压降近似为该阻抗乘电流
+		 */
+		double impedance(double resistance, double reactance) const
+		{
+			return resistance * power_factor + reactance * std::sqrt(1 - power_factor * power_factor);
+		}
+
+		/**
+		 * 住户的电流：附表、extra中的"load"、default_load依次取第一个给出的值
+		 */
+		double load(const Hole& house) const
+		{
+			if (auto it = loads.find(house.id); it != loads.end())
+			{
+				return it->second;
+			}
+			if (house.extra.is_object() && house.extra.contains("load"))
+			{
+				return checkedLoad(house.extra.at("load").get<double>(), house.id);
+			}
+			return default_load;
+		}
+
+		/**
+		 * 链的单位长度阻抗，供电端点extra中的"resistance"、"reactance"覆盖默认值
+		 */
+		double impedance(const Hole& endpoint) const
+		{
+			auto resistance = this->resistance, reactance = this->reactance;
+			if (endpoint.extra.is_object())
+			{
+				resistance = endpoint.extra.value("resistance", resistance);
+				reactance = endpoint.extra.value("reactance", reactance);
+			}
+			if (!(resistance >= 0) || !(reactance >= 0))
+			{
+				throw std::invalid_argument("invalid cable impedance at endpoint: " + endpoint.id);
+			}
+			return impedance(resistance, reactance);
+		}
+
+	private:
+		static double checkedLoad(double load, const std::string& id)
+		{
+			if (!(load >= 0) || !std::isfinite(load))
+			{
+				throw std::invalid_argument("invalid load of house: " + id);
+			}
+			return load;
+		}
+	};
+
+	/**
+	 * VoltageDrop，沿地图最优分割（与/api/map/split的默认方案相同）得到的各条线缆链计算电流和电压降
+	 *
+	 * 每条链为电线杆 - 供电端点 - 各住户，住户负荷视为恒定电流。第i段线缆的电流为其后所有住户电流之和，
+	 * 到第i个结点的电压降为前i段的长度×电流之和乘单位长度阻抗，沿链单调增加，末端最大。
+	 * 所有链的结点拍平为结构数组批量计算：先一次求出所有线缆段的长度（地理坐标地图调用haversine批量内核），
+	 * 再按链并行做两遍没有分支的累加
+	 */
+	class VoltageDrop {
+	public:
+		VoltageDrop(const MapVersion& map, VoltageParams params)
+			: map_{ map }, params_{ std::move(params) }
+		{
+		}
+
+		/**
+		 * 返回{"version", "voltage", "max_drop", "chains", "houses", "max_drop_ratio", "violations", "infeasible"}，
+		 * violations为末端电压降超过max_drop的链，按房屋组下标排列，每项为{"index", "side", "elec", "houses",
+		 * "current", "drop", "drop_ratio", "end_voltage", "first_violation"}，first_violation为第一个超限的住户ID。
+		 * 没有可用端点的房屋组列在infeasible中
+		 */
+		nlohmann::json run(size_t threads = std::thread::hardware_concurrency()) const
+		{
+			const auto& groups = map_.groups;
+			std::vector<GroupSplit> splits(groups.size());
+			parallelFor(groups.size(), [&](size_t i) { splits[i] = bestSplit(*groups[i]); }, threads, 256);
+
+			// 每条链占points中连续的结点：电线杆、供电端点、按供电顺序排列的住户
+			std::vector<Chain> chains;
+			size_t total = 0;
+			for (size_t i = 0; i < groups.size(); ++i)
+			{
+				const auto& split = splits[i];
+				auto n = groups[i]->group.house_poles.size();
+				if (!split.feasible)
+				{
+					continue;
+				}
+				if (split.front_houses > 0)
+				{
+					chains.push_back({ i, true, total, split.front_houses });
+					total += split.front_houses + 2;
+				}
+				if (split.front_houses < n)
+				{
+					chains.push_back({ i, false, total, n - split.front_houses });
+					total += n - split.front_houses + 2;
+				}
+			}
+
+			std::vector<const Hole*> points(total);
+			std::vector<double> load(total), impedance(chains.size());
+			parallelFor(chains.size(), [&](size_t c) {
+				const auto& chain = chains[c];
+				const auto& entry = *groups[chain.group];
+				const auto& houses = entry.group.house_poles;
+				const auto& endpoint = chain.front ? entry.group.group_front_pole : entry.group.group_back_pole;
+				auto p = chain.offset;
+				points[p] = &map_.elec->at((chain.front ? entry.front : entry.back).elec_id);
+				points[p + 1] = &endpoint;
+				for (size_t k = 0; k < chain.houses; ++k)
+				{
+					const auto& house = chain.front ? houses[k] : houses[houses.size() - 1 - k];
+					points[p + 2 + k] = &house;
+					load[p + 2 + k] = params_.load(house);
+				}
+				impedance[c] = params_.impedance(endpoint);
+				}, threads, 256);
+
+			auto length = segmentLengths(points);
+
+			// 第一遍求链的总电流，第二遍从电线杆向末端累加各段的长度×电流
+			std::vector<double> drop(total);
+			std::vector<Result> results(chains.size());
+			parallelFor(chains.size(), [&](size_t c) {
+				const auto& chain = chains[c];
+				const auto begin = chain.offset + 1, end = chain.offset + chain.houses + 2;
+				double current = 0;
+				for (auto i = begin; i < end; ++i)
+				{
+					current += load[i];
+				}
+				results[c].current = current;
+				double sum = 0;
+				for (auto i = begin; i < end; ++i)
+				{
+					sum += length[i] * current;
+					current -= load[i];
+					drop[i] = sum;
+				}
+				results[c].drop = sum * impedance[c];
+				}, threads, 256);
+
+			nlohmann::json j;
+			j["version"] = map_.version;
+			j["voltage"] = params_.voltage;
+			j["max_drop"] = params_.max_drop;
+			j["chains"] = chains.size();
+			auto limit = params_.voltage * params_.max_drop;
+			size_t house_count = 0;
+			double worst = 0;
+			auto& violations = j["violations"] = nlohmann::json::array();
+			for (size_t c = 0; c < chains.size(); ++c)
+			{
+				const auto& chain = chains[c];
+				const auto& result = results[c];
+				house_count += chain.houses;
+				worst = std::max(worst, result.drop / params_.voltage);
+				if (!(result.drop > limit))
+				{
+					continue;
+				}
+				// 电压降沿链单调增加，二分找到第一个超限的住户
+				auto first = chain.offset + 2, last = chain.offset + chain.houses + 2;
+				auto it = std::upper_bound(drop.begin() + first, drop.begin() + last, limit / impedance[c]);
+				const auto& entry = *groups[chain.group];
+				nlohmann::json v;
+				v["index"] = chain.group;
+				v["side"] = chain.front ? "front" : "back";
+				v["elec"] = (chain.front ? entry.front : entry.back).elec_id;
+				v["houses"] = chain.houses;
+				v["current"] = result.current;
+				v["drop"] = result.drop;
+				v["drop_ratio"] = result.drop / params_.voltage;
+				v["end_voltage"] = params_.voltage - result.drop;
+				v["first_violation"] = it == drop.begin() + last ? nlohmann::json() : nlohmann::json(points[it - drop.begin()]->id);
+				violations.push_back(std::move(v));
+			}
+			j["houses"] = house_count;
+			j["max_drop_ratio"] = worst;
+			auto& infeasible = j["infeasible"] = nlohmann::json::array();
+			for (size_t i = 0; i < splits.size(); ++i)
+			{
+				if (!splits[i].feasible)
+				{
+					infeasible.push_back(i);
+				}
+			}
+			return j;
+		}
+
+	private:
+		struct Chain {
+			size_t group;
+			bool front;
+			/**
+			 * 在结点数组中的起始位置，结点数为houses + 2
+			 */
+			size_t offset;
+			size_t houses;
+		};
+
+		struct Result {
+			double current{};
+			double drop{};
+		};
+
+		/**
+		 * length[i]为结点i - 1到结点i的线缆长度，每条链第一个结点（电线杆）的值无意义。
+		 * 平面地图按欧氏距离，地理坐标地图反投影后一次调用haversine批量内核
+		 */
+		std::vector<double> segmentLengths(const std::vector<const Hole*>& points) const
+		{
+			const auto n = points.size();
+			std::vector<double> length(n);
+			if (n < 2)
+			{
+				return length;
+			}
+			std::vector<double> x(n), y(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				x[i] = points[i]->x;
+				y[i] = points[i]->y;
+			}
+			if (map_.geo)
+			{
+				for (size_t i = 0; i < n; ++i)
+				{
+					std::tie(x[i], y[i]) = map_.geo->unproject(x[i], y[i]);
+					x[i] *= radian;
+					y[i] *= radian;
+				}
+				GeoFrame::haversine(n - 1, x.data(), y.data(), x.data() + 1, y.data() + 1, length.data() + 1);
+			}
+			else
+			{
+				for (size_t i = 1; i < n; ++i)
+				{
+					auto dx = x[i] - x[i - 1], dy = y[i] - y[i - 1];
+					length[i] = std::sqrt(dx * dx + dy * dy);
+				}
+			}
+			return length;
+		}
+
+		static constexpr double radian = 3.14159265358979323846 / 180;
+
+		const MapVersion& map_;
+		VoltageParams params_;
+	};
+}
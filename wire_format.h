@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace ohtoai {
+	/**
+	 * WireFormat，响应和请求体的编码方式
+	 */
+	enum class WireFormat : unsigned {
+		json,
+		pretty_json,
+		msgpack,
+		cbor,
+		bson,
+	};
+
+	inline const char* contentType(WireFormat format)
+	{
+		switch (format)
+		{
+		case WireFormat::msgpack: return "application/msgpack";
+		case WireFormat::cbor: return "application/cbor";
+		case WireFormat::bson: return "application/bson";
+		default: return "application/json";
+		}
+	}
+
+	// 按媒体类型识别编码方式，不认识的返回false
+	inline bool parseMediaType(std::string type, WireFormat& format)
+	{
+		if (auto semicolon = type.find(';'); semicolon != std::string::npos)
+		{
+			type.resize(semicolon);
+		}
+		type.erase(0, type.find_first_not_of(" \t"));
+		type.erase(type.find_last_not_of(" \t") + 1);
+		std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		if (type == "application/msgpack" || type == "application/x-msgpack" || type == "application/vnd.msgpack")
+		{
+			format = WireFormat::msgpack;
+		}
+		else if (type == "application/cbor")
+		{
+			format = WireFormat::cbor;
+		}
+		else if (type == "application/bson")
+		{
+			format = WireFormat::bson;
+		}
+		else if (type == "application/json" || type == "application/*" || type == "*/*")
+		{
+			format = WireFormat::json;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * 按Accept头选择响应编码，取q值最高的可用类型，相同时取先出现的；
+	 * 没有可用类型时使用JSON。BSON的根只能是对象，object_root为false时不选BSON。
+	 * pretty只对JSON生效
+	 */
+	inline WireFormat negotiate(const std::string& accept, bool pretty, bool object_root = true)
+	{
+		auto best = WireFormat::json;
+		auto best_q = -1.0;
+		size_t start = 0;
+		while (start <= accept.size())
+		{
+			auto end = std::min(accept.find(',', start), accept.size());
+			auto item = accept.substr(start, end - start);
+			start = end + 1;
+
+			WireFormat format{};
+			if (!parseMediaType(item, format) || (format == WireFormat::bson && !object_root))
+			{
+				continue;
+			}
+			auto q = 1.0;
+			if (auto pos = item.find("q="); pos != std::string::npos)
+			{
+				q = std::atof(item.c_str() + pos + 2);
+			}
+			if (q > 0 && q > best_q)
+			{
+				best = format;
+				best_q = q;
+			}
+		}
+		return best == WireFormat::json && pretty ? WireFormat::pretty_json : best;
+	}
+
+	inline std::string encode(const nlohmann::json& j, WireFormat format)
+	{
+		std::string out;
+		switch (format)
+		{
+		case WireFormat::pretty_json:
+			return j.dump(4);
+		case WireFormat::msgpack:
+			nlohmann::json::to_msgpack(j, out);
+			return out;
+		case WireFormat::cbor:
+			nlohmann::json::to_cbor(j, out);
+			return out;
+		case WireFormat::bson:
+			nlohmann::json::to_bson(j, out);
+			return out;
+		default:
+			return j.dump();
+		}
+	}
+
+	// 按Content-Type解码请求体，未指明或不认识的类型按JSON解析
+	inline nlohmann::json decode(const std::string& body, const std::string& content_type)
+	{
+		auto format = WireFormat::json;
+		parseMediaType(content_type, format);
+		switch (format)
+		{
+		case WireFormat::msgpack: return nlohmann::json::from_msgpack(body);
+		case WireFormat::cbor: return nlohmann::json::from_cbor(body);
+		case WireFormat::bson: return nlohmann::json::from_bson(body);
+		default: return nlohmann::json::parse(body);
+		}
+	}
+}
@@ -0,0 +1,486 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include "map_store.h"
+#include "delaunay.h"
+
+namespace ohtoai {
+	/**
+	 * WiringOptions，全图接线树参数
+	 */
+	struct WiringOptions {
+		/**
+		 * 是否用费马点插入斯坦纳点进一步缩短线缆
+		 */
+		bool steiner{};
+		/**
+		 * 是否返回每条边，大地图上只需要总长时可关闭
+		 */
+		bool edges{ true };
+	};
+
+	/**
+	 * WiringPlanner，把所有住户接到电线杆集合上的最短线缆网络（多源欧氏最小生成树）
+	 *
+	 * 所有电线杆预先并为一个连通分量，再在住户和电线杆的Delaunay三角剖分边上做Kruskal。
+	 * 欧氏最小生成树的边都在Gabriel图中，而Gabriel图是Delaunay图的子图；
+	 * 电线杆之间的边长视为0不影响这一点，因此只需考虑O(n)条边，总耗时O(n log n)。
+	 * 结果中每棵树恰好含一个电线杆，边由电线杆一侧指向住户一侧。
+	 * 开启steiner时，对树上夹角小于120°的相邻两边，按节省长度从大到小
+	 * 将其替换为到费马点的三条边，每条边至多参与一次替换。
+	 */
+	class WiringPlanner {
+	public:
+		WiringPlanner(const MapVersion& map, WiringOptions options)
+			: map_{ map }, options_{ options }
+		{
+		}
+
+		/**
+		 * 返回{"version", "total_length", "mst_length", "steiner_saving", "steiner_points", "poles", "edges"}，
+		 * poles中每项为{"elec", "houses", "cable"}，只列出接有住户的电线杆；
+		 * edges中每项为{"from", "to", "length"}，端点为{"group", "position"}、{"elec"}或{"steiner"}。
+		 * 地理坐标地图的树和斯坦纳点在投影平面上求出，斯坦纳点返回经纬度，长度按球面距离（米）报告。
+		 * 地图没有电线杆时抛出std::invalid_argument
+		 */
+		nlohmann::json run()
+		{
+			collect();
+			spanningTree();
+			mst_length_ = reportedLength();
+			if (options_.steiner)
+			{
+				insertSteinerPoints();
+			}
+			measure();
+			orient();
+			return result();
+		}
+
+	private:
+		// 节点：住户(group, position)、电线杆(pole)或斯坦纳点
+		struct Node {
+			double x;
+			double y;
+			size_t group;
+			size_t position;
+			size_t pole;
+		};
+
+		struct Edge {
+			size_t a;
+			size_t b;
+			double length;
+		};
+
+		static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+		void collect()
+		{
+			const auto& poles = map_.elec->poles;
+			if (poles.empty())
+			{
+				throw std::invalid_argument("map has no elec poles to wire houses to");
+			}
+			for (size_t i = 0; i < map_.groups.size(); ++i)
+			{
+				const auto& houses = map_.groups[i]->group.house_poles;
+				for (size_t p = 0; p < houses.size(); ++p)
+				{
+					nodes_.push_back({ houses[p].x, houses[p].y, i, p, none });
+				}
+			}
+			house_count_ = nodes_.size();
+			for (size_t j = 0; j < poles.size(); ++j)
+			{
+				nodes_.push_back({ poles[j].x, poles[j].y, none, none, j });
+			}
+		}
+
+		double length(size_t a, size_t b) const
+		{
+			return std::hypot(nodes_[a].x - nodes_[b].x, nodes_[a].y - nodes_[b].y);
+		}
+
+		bool isPole(size_t n) const
+		{
+			return nodes_[n].pole != none;
+		}
+
+		size_t find(size_t n)
+		{
+			while (parent_[n] != n)
+			{
+				n = parent_[n] = parent_[parent_[n]];
+			}
+			return n;
+		}
+
+		bool unite(size_t a, size_t b)
+		{
+			a = find(a);
+			b = find(b);
+			if (a == b)
+			{
+				return false;
+			}
+			if (rank_[a] < rank_[b])
+			{
+				std::swap(a, b);
+			}
+			parent_[b] = a;
+			rank_[a] += rank_[a] == rank_[b] ? 1 : 0;
+			return true;
+		}
+
+		void spanningTree()
+		{
+			const auto n = nodes_.size();
+			parent_.resize(n);
+			std::iota(parent_.begin(), parent_.end(), 0);
+			rank_.assign(n, 0);
+			for (auto j = house_count_ + 1; j < n; ++j)
+			{
+				unite(house_count_, j);
+			}
+
+			// 坐标完全相同的点只有第一个参与三角剖分，其余以0长度的边接到它上面
+			std::vector<Edge> candidates;
+			std::vector<size_t> distinct;
+			std::unordered_map<std::pair<double, double>, size_t, CoordHash> first;
+			for (size_t i = 0; i < n; ++i)
+			{
+				auto [it, inserted] = first.emplace(std::pair{ nodes_[i].x, nodes_[i].y }, i);
+				if (inserted)
+				{
+					distinct.push_back(i);
+				}
+				else
+				{
+					candidates.push_back({ it->second, i, 0.0 });
+				}
+			}
+
+			std::vector<double> coords;
+			coords.reserve(distinct.size() * 2);
+			for (auto i : distinct)
+			{
+				coords.push_back(nodes_[i].x);
+				coords.push_back(nodes_[i].y);
+			}
+			Delaunay delaunay{ std::move(coords) };
+			std::vector<bool> covered(distinct.size());
+			delaunay.forEachEdge([&](size_t a, size_t b) {
+				candidates.push_back({ distinct[a], distinct[b], length(distinct[a], distinct[b]) });
+				covered[a] = covered[b] = true;
+				});
+			// 浮点误差下个别几乎重合的点可能未进入三角剖分，接到最近的点上
+			std::vector<PointIndex<size_t>::Entry> entries;
+			for (size_t k = 0; k < distinct.size(); ++k)
+			{
+				if (covered[k])
+				{
+					entries.push_back({ nodes_[distinct[k]].x, nodes_[distinct[k]].y, distinct[k] });
+				}
+			}
+			PointIndex<size_t> index{ std::move(entries) };
+			for (size_t k = 0; k < distinct.size(); ++k)
+			{
+				if (!covered[k])
+				{
+					auto i = distinct[k];
+					for (const auto& [distance, e] : index.nearest(nodes_[i].x, nodes_[i].y, 1))
+					{
+						candidates.push_back({ e->value, i, distance });
+					}
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [](const Edge& a, const Edge& b) { return a.length < b.length; });
+			for (const auto& e : candidates)
+			{
+				if (unite(e.a, e.b))
+				{
+					edges_.push_back(e);
+				}
+			}
+		}
+
+		double totalLength() const
+		{
+			double total = 0;
+			for (const auto& e : edges_)
+			{
+				total += e.length;
+			}
+			return total;
+		}
+
+		// 边的报告长度，地理坐标地图按球面距离重新计算
+		double reportedLength(const Edge& e) const
+		{
+			const auto& a = nodes_[e.a];
+			const auto& b = nodes_[e.b];
+			return map_.geo ? map_.geo->length(a.x, a.y, b.x, b.y) : e.length;
+		}
+
+		double reportedLength() const
+		{
+			double total = 0;
+			for (const auto& e : edges_)
+			{
+				total += reportedLength(e);
+			}
+			return total;
+		}
+
+		// 树已确定，地理坐标地图的边长换为球面距离，供统计和输出使用
+		void measure()
+		{
+			if (!map_.geo)
+			{
+				return;
+			}
+			for (auto& e : edges_)
+			{
+				e.length = reportedLength(e);
+			}
+		}
+
+		// 三角形abc的费马点，Weiszfeld迭代，调用方保证三个内角都小于120°
+		std::pair<double, double> fermatPoint(size_t a, size_t b, size_t c) const
+		{
+			auto x = (nodes_[a].x + nodes_[b].x + nodes_[c].x) / 3;
+			auto y = (nodes_[a].y + nodes_[b].y + nodes_[c].y) / 3;
+			for (int iteration = 0; iteration < 64; ++iteration)
+			{
+				double wx = 0, wy = 0, w = 0;
+				for (auto n : { a, b, c })
+				{
+					auto d = std::hypot(nodes_[n].x - x, nodes_[n].y - y);
+					if (d < 1e-12)
+					{
+						return { x, y };
+					}
+					wx += nodes_[n].x / d;
+					wy += nodes_[n].y / d;
+					w += 1 / d;
+				}
+				auto nx = wx / w, ny = wy / w;
+				auto moved = std::abs(nx - x) + std::abs(ny - y);
+				x = nx;
+				y = ny;
+				if (moved < 1e-12 * (1 + std::abs(x) + std::abs(y)))
+				{
+					break;
+				}
+			}
+			return { x, y };
+		}
+
+		// 顶点v处夹角的余弦
+		double cosAngle(size_t v, size_t a, size_t b) const
+		{
+			auto ax = nodes_[a].x - nodes_[v].x, ay = nodes_[a].y - nodes_[v].y;
+			auto bx = nodes_[b].x - nodes_[v].x, by = nodes_[b].y - nodes_[v].y;
+			auto la = std::hypot(ax, ay), lb = std::hypot(bx, by);
+			return la == 0 || lb == 0 ? 1.0 : (ax * bx + ay * by) / (la * lb);
+		}
+
+		void insertSteinerPoints()
+		{
+			std::vector<std::vector<size_t>> incident(nodes_.size());
+			for (size_t e = 0; e < edges_.size(); ++e)
+			{
+				incident[edges_[e].a].push_back(e);
+				incident[edges_[e].b].push_back(e);
+			}
+
+			struct Candidate {
+				double saving;
+				size_t vertex;
+				size_t first;
+				size_t second;
+				double x;
+				double y;
+			};
+			std::vector<Candidate> candidates;
+			for (size_t v = 0; v < nodes_.size(); ++v)
+			{
+				const auto& around = incident[v];
+				for (size_t i = 0; i < around.size(); ++i)
+				{
+					for (size_t k = i + 1; k < around.size(); ++k)
+					{
+						auto a = other(around[i], v), b = other(around[k], v);
+						// cos 120° = -0.5，三个内角都小于120°时费马点在三角形内部
+						if (cosAngle(v, a, b) <= -0.5 || cosAngle(a, v, b) <= -0.5 || cosAngle(b, v, a) <= -0.5)
+						{
+							continue;
+						}
+						auto [x, y] = fermatPoint(v, a, b);
+						auto saving = edges_[around[i]].length + edges_[around[k]].length
+							- std::hypot(nodes_[v].x - x, nodes_[v].y - y)
+							- std::hypot(nodes_[a].x - x, nodes_[a].y - y)
+							- std::hypot(nodes_[b].x - x, nodes_[b].y - y);
+						if (saving > 1e-9)
+						{
+							candidates.push_back({ saving, v, around[i], around[k], x, y });
+						}
+					}
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.saving > b.saving; });
+
+			std::vector<bool> used(edges_.size());
+			for (const auto& c : candidates)
+			{
+				if (used[c.first] || used[c.second])
+				{
+					continue;
+				}
+				used[c.first] = used[c.second] = true;
+				auto a = other(c.first, c.vertex), b = other(c.second, c.vertex);
+				auto s = nodes_.size();
+				nodes_.push_back({ c.x, c.y, none, none, none });
+				edges_[c.first] = { c.vertex, s, length(c.vertex, s) };
+				edges_[c.second] = { a, s, length(a, s) };
+				edges_.push_back({ b, s, length(b, s) });
+			}
+		}
+
+		size_t other(size_t edge, size_t v) const
+		{
+			return edges_[edge].a == v ? edges_[edge].b : edges_[edge].a;
+		}
+
+		// 从各电线杆出发广度优先遍历，使每条边由电线杆一侧指向外侧，并统计每个电线杆的住户数和线缆长度
+		void orient()
+		{
+			std::vector<std::vector<size_t>> incident(nodes_.size());
+			for (size_t e = 0; e < edges_.size(); ++e)
+			{
+				incident[edges_[e].a].push_back(e);
+				incident[edges_[e].b].push_back(e);
+			}
+			const auto pole_count = map_.elec->poles.size();
+			pole_houses_.assign(pole_count, 0);
+			pole_cable_.assign(pole_count, 0.0);
+
+			std::vector<bool> visited(nodes_.size());
+			std::vector<size_t> queue;
+			for (size_t root = house_count_; root < house_count_ + pole_count; ++root)
+			{
+				auto pole = nodes_[root].pole;
+				queue.assign(1, root);
+				visited[root] = true;
+				for (size_t head = 0; head < queue.size(); ++head)
+				{
+					auto v = queue[head];
+					for (auto e : incident[v])
+					{
+						auto u = other(e, v);
+						// 电线杆之间没有边，遇到别的电线杆只可能是它本身所在的重复坐标
+						if (visited[u] || isPole(u))
+						{
+							continue;
+						}
+						visited[u] = true;
+						edges_[e].a = v;
+						edges_[e].b = u;
+						pole_cable_[pole] += edges_[e].length;
+						pole_houses_[pole] += u < house_count_ ? 1 : 0;
+						queue.push_back(u);
+					}
+				}
+			}
+		}
+
+		nlohmann::json node(size_t n) const
+		{
+			nlohmann::json j;
+			const auto& node = nodes_[n];
+			if (n < house_count_)
+			{
+				j["group"] = node.group;
+				j["position"] = node.position;
+			}
+			else if (node.pole != none)
+			{
+				j["elec"] = map_.elec->poles[node.pole].id;
+			}
+			else
+			{
+				j["steiner"] = n - house_count_ - map_.elec->poles.size();
+			}
+			return j;
+		}
+
+		nlohmann::json result() const
+		{
+			nlohmann::json j;
+			j["version"] = map_.version;
+			auto total = totalLength();
+			j["total_length"] = total;
+			j["mst_length"] = mst_length_;
+			j["steiner_saving"] = mst_length_ - total;
+
+			auto& steiner = j["steiner_points"] = nlohmann::json::array();
+			for (auto n = house_count_ + map_.elec->poles.size(); n < nodes_.size(); ++n)
+			{
+				auto [x, y] = map_.geo ? map_.geo->unproject(nodes_[n].x, nodes_[n].y) : std::pair{ nodes_[n].x, nodes_[n].y };
+				steiner.push_back({ { "x", x }, { "y", y } });
+			}
+
+			auto& poles = j["poles"] = nlohmann::json::array();
+			for (size_t p = 0; p < pole_houses_.size(); ++p)
+			{
+				if (pole_houses_[p] > 0)
+				{
+					nlohmann::json pole;
+					pole["elec"] = map_.elec->poles[p].id;
+					pole["houses"] = pole_houses_[p];
+					pole["cable"] = pole_cable_[p];
+					poles.push_back(std::move(pole));
+				}
+			}
+
+			if (options_.edges)
+			{
+				auto& edges = j["edges"] = nlohmann::json::array();
+				for (const auto& e : edges_)
+				{
+					nlohmann::json edge;
+					edge["from"] = node(e.a);
+					edge["to"] = node(e.b);
+					edge["length"] = e.length;
+					edges.push_back(std::move(edge));
+				}
+			}
+			return j;
+		}
+
+		struct CoordHash {
+			size_t operator()(const std::pair<double, double>& p) const
+			{
+				return std::hash<double>{}(p.first) * 31 + std::hash<double>{}(p.second);
+			}
+		};
+
+		const MapVersion& map_;
+		WiringOptions options_;
+		std::vector<Node> nodes_;
+		size_t house_count_{};
+		std::vector<size_t> parent_;
+		std::vector<unsigned char> rank_;
+		std::vector<Edge> edges_;
+		double mst_length_{};
+		std::vector<size_t> pole_houses_;
+		std::vector<double> pole_cable_;
+	};
+}